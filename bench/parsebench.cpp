@@ -0,0 +1,196 @@
+// parser microbenchmark
+// generates a float heavy .world file and measures how fast it can be parsed
+// build with `make bench` (pass CFLAGS="-O2" to measure an optimized build) and run ./bin/parsebench [objects] [iterations]
+
+#include <world.hpp>
+#include <utils.hpp>
+#include <scan.hpp>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+
+// write a world made up of object blocks with long, random floats
+std::string generateFloatWorld(uint32_t objects){
+	std::string world = "# float heavy benchmark world\n\n*[cube, cube, 0, 0, 0, 1, 1, 1]\n\n";
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<double> position(-1000.0, 1000.0);
+	std::uniform_real_distribution<double> scale(0.1, 10.0);
+
+	char block[512];
+
+	for(uint32_t i = 0; i < objects; i++){
+		snprintf(block, sizeof(block), "$[%.17g, %.17g, %.17g, %.17g, %.17g, %.17g, %.17g, %.17g, %.17g, default, cube]\n",
+			position(random), position(random), position(random),
+			0.0, 90.0, 0.0,
+			scale(random), scale(random), scale(random)
+		);
+
+		world += block;
+	}
+
+	return world;
+}
+
+// split every parameter out of the world (only used to feed the number benchmarks below)
+void collectParameters(std::string& world, std::vector<std::string>& parameters){
+	std::string parameter;
+
+	for(uint32_t i = 0; i < world.length(); i++){
+		char byte = world[i];
+
+		if(byte == ',' || byte == ']'){
+			parameters.push_back(parameter);
+			parameter.clear();
+		} else if(byte == '['){
+			parameter.clear();
+		} else if(!isspace(byte)){
+			parameter.push_back(byte);
+		}
+	}
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start){
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	return elapsed.count();
+}
+
+int main(int argc, char** argv){
+	uint32_t objects = argc > 1 ? atoi(argv[1]) : 200000;
+	uint32_t iterations = argc > 2 ? atoi(argv[2]) : 5;
+
+	printf("Generating float heavy world (%d objects)...\n", objects);
+
+	std::string world = generateFloatWorld(objects);
+	double megabytes = world.length() / (1024.0 * 1024.0);
+
+	// number classification, old vs new
+	std::vector<std::string> parameters;
+	collectParameters(world, parameters);
+
+	printf("Classifying + converting %zu parameters (%d iterations)...\n", parameters.size(), iterations);
+
+	// old path: strtod to classify, then std::stof to convert
+	double oldChecksum = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for(uint32_t n = 0; n < iterations; n++){
+		for(uint32_t i = 0; i < parameters.size(); i++){
+			char* p;
+			strtod(parameters[i].c_str(), &p);
+
+			if(parameters[i].length() > 0 && *p == 0) oldChecksum += std::stof(parameters[i]);
+		}
+	}
+
+	double oldSeconds = secondsSince(start);
+
+	// new path: single from_chars pass
+	double newChecksum = 0;
+	start = std::chrono::steady_clock::now();
+
+	for(uint32_t n = 0; n < iterations; n++){
+		for(uint32_t i = 0; i < parameters.size(); i++){
+			float f;
+
+			if(parseNumber(parameters[i], f)) newChecksum += f;
+		}
+	}
+
+	double newSeconds = secondsSince(start);
+
+	double parameterCount = (double)parameters.size() * iterations;
+
+	printf(" - strtod + stof: %.1f M parameters/s\n", parameterCount / oldSeconds / 1e6);
+	printf(" - from_chars:    %.1f M parameters/s (%.2fx)\n", parameterCount / newSeconds / 1e6, oldSeconds / newSeconds);
+
+	// both paths should have produced the same values
+	if(oldChecksum != newChecksum) printf(" - WARNING: checksums differ (%f vs %f)\n", oldChecksum, newChecksum);
+
+	// structural scanning, per kernel
+	ScanSet structural = createScanSet("[]{},\n$*+~");
+	ScanKernel kernels[] = {SCAN_KERNEL_SCALAR, SCAN_KERNEL_SSE2, SCAN_KERNEL_AVX2};
+	
+	printf("Scanning for structural bytes (%d iterations)...\n", iterations);
+	
+	for(ScanKernel kernel : kernels){
+		if(setScanKernel(kernel) != kernel) continue;
+		
+		size_t found = 0;
+		start = std::chrono::steady_clock::now();
+		
+		for(uint32_t n = 0; n < iterations; n++){
+			ScanCursor cursor = createScanCursor(world.data(), world.length(), &structural);
+			
+			while(scanNext(cursor) < world.length()) found++;
+		}
+		
+		double scanSeconds = secondsSince(start);
+		
+		printf(" - %-6s: %.2f GB/s (%zu structural bytes per pass)\n", getScanKernelName(kernel), world.length() * (double)iterations / scanSeconds / 1e9, found / iterations);
+	}
+	
+	// full parse
+	char path[] = "/tmp/parsebench-XXXXXX";
+	int fd = mkstemp(path);
+	
+	if(fd < 0){
+		perror("mkstemp");
+		return EXIT_FAILURE;
+	}
+	
+	FILE* file = fdopen(fd, "wb");
+	fwrite(world.data(), 1, world.length(), file);
+	fclose(file);
+	
+	printf("Parsing %.1f MB world (%d iterations)...\n", megabytes, iterations);
+	
+	// every kernel has to produce the same scene as the scalar kernel
+	double scalarFingerprint = 0;
+	
+	for(ScanKernel kernel : kernels){
+		if(setScanKernel(kernel) != kernel) continue;
+		
+		start = std::chrono::steady_clock::now();
+		
+		size_t parsedObjects = 0;
+		double fingerprint = 0;
+		
+		for(uint32_t n = 0; n < iterations; n++){
+			Scene* scene = parseWorld(path, 1, false);
+			
+			if(scene == NULL) break;
+			
+			ObjectArrays* objects = scene->objects;
+			
+			parsedObjects += objects->positions.size();
+			
+			// fingerprint
+			for(uint32_t i = 0; i < objects->positions.size(); i++){
+				glm::vec3 position = objects->positions[i];
+				glm::vec3 scale = objects->scales[i];
+				
+				fingerprint += (i+1) * (double)(position.x + position.y + position.z + scale.x + scale.y + scale.z);
+			}
+			
+			destroyScene(scene);
+		}
+		
+		double parseSeconds = secondsSince(start);
+		
+		if(kernel == SCAN_KERNEL_SCALAR) scalarFingerprint = fingerprint;
+		
+		printf(" - parseWorld (%s): %.1f MB/s (%zu objects per parse)%s\n", getScanKernelName(kernel), megabytes * iterations / parseSeconds, parsedObjects / iterations, fingerprint != scalarFingerprint ? " WARNING: scene differs from scalar kernel" : "");
+	}
+	
+	remove(path);
+
+	return EXIT_SUCCESS;
+}
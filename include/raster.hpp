@@ -0,0 +1,53 @@
+// raster walkmap engine (rasterizes each height into cells and meshes them back into boxes)
+
+#ifndef WALKMAP_RASTER_H
+#define WALKMAP_RASTER_H
+
+#include <walkmap.hpp>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+// every object with the same top face height rasterized into cells
+// cells are shared by every layer, cell (x, z) covers [x, x+1) * resolution on each axis
+struct RasterLayer {
+	float height;
+	
+	// first cell of the layer and its size in cells
+	glm::ivec2 origin;
+	uint32_t width, depth;
+	
+	// object each cell is walkable on (UINT32_MAX if it's not walkable), only kept until the layer is meshed
+	std::vector<uint32_t> owners;
+	
+	// box each cell was meshed into (UINT32_MAX if it's not walkable)
+	std::vector<uint32_t> boxes;
+};
+
+// rectangle of cells in a layer, every cell is walkable on the same object
+struct RasterBox {
+	uint32_t layer;
+	uint32_t owner;
+	
+	// first and last cell (inclusive)
+	glm::ivec2 first, last;
+};
+
+// box a cell of a layer was meshed into (UINT32_MAX if it's not walkable or outside of the layer)
+uint32_t getLayerBox(const RasterLayer* layer, int32_t x, int32_t z);
+
+// rasterize the objects in height positions [begin, end) (which all have the same top) and block every cell an object above them gets in the way of
+void rasterizeLayer(WalkmapGenerator* generator, RasterLayer* layer, uint32_t begin, uint32_t end);
+
+// greedily mesh the walkable cells of a layer into boxes
+void meshLayer(RasterLayer* layer, uint32_t layerIndex, std::vector<RasterBox>& boxes);
+
+// links between boxes in the same layer that share an edge and boxes in layers that can be stepped between whose footprints touch
+void linkRasterBoxes(WalkmapGenerator* generator, const std::vector<RasterLayer>& layers, const std::vector<RasterBox>& boxes, std::vector<std::pair<uint32_t, uint32_t>>& links);
+
+void generateRasterWalkmap(WalkmapSettings& settings, const ObjectArrays* objects, CompactWalkmap* walkmap);
+
+#endif
@@ -0,0 +1,82 @@
+// vectorized byte scanning used by the world parser
+
+#ifndef WALKMAP_SCAN_H
+#define WALKMAP_SCAN_H
+
+#include <cstdint>
+#include <cstddef>
+
+// maximum amount of bytes a scan set can look for
+#define SCAN_SET_CAPACITY 16
+
+// bytes per scanned block (one bit per byte in a mask)
+#define SCAN_BLOCK_SIZE 64
+
+// set of bytes to scan for
+struct ScanSet {
+	// every byte in the set repeated 32 times, so kernels can load them straight into vector registers
+	alignas(32) uint8_t splats[SCAN_SET_CAPACITY][32];
+	uint32_t count;
+	
+	// 256 entry lookup table for the scalar kernel (and for partial blocks at the end of a buffer)
+	bool table[256];
+};
+
+// cursor over every byte of a buffer that's in a scan set
+// blocks of SCAN_BLOCK_SIZE bytes are classified at once into a bitmask, which is then consumed one bit at a time
+struct ScanCursor {
+	const char* data;
+	size_t size;
+	const ScanSet* set;
+	
+	// start of the block the mask belongs to
+	size_t block;
+	
+	// bytes in the block that haven't been returned yet
+	uint64_t mask;
+};
+
+// available scanning kernels (picked at runtime based on what the cpu supports)
+enum ScanKernel {
+	SCAN_KERNEL_AUTO = 0,
+	SCAN_KERNEL_SCALAR,
+	SCAN_KERNEL_SSE2,
+	SCAN_KERNEL_AVX2
+};
+
+// create a scan set from a null terminated string of bytes (at most SCAN_SET_CAPACITY)
+ScanSet createScanSet(const char* bytes);
+
+// create a cursor positioned at the start of data
+ScanCursor createScanCursor(const char* data, size_t size, const ScanSet* set);
+
+// position the cursor so the next call to scanNext returns the first byte at or after index
+void scanSeek(ScanCursor& cursor, size_t index);
+
+// classify a single block (used by scanNext when the mask runs out)
+uint64_t scanBlock(const ScanCursor& cursor, size_t block);
+
+// returns the index of the next byte in the set, or size if there aren't any left
+inline size_t scanNext(ScanCursor& cursor){
+	while(cursor.mask == 0){
+		cursor.block += SCAN_BLOCK_SIZE;
+		
+		if(cursor.block >= cursor.size) return cursor.size;
+		
+		cursor.mask = scanBlock(cursor, cursor.block);
+	}
+	
+	size_t index = cursor.block + __builtin_ctzll(cursor.mask);
+	
+	// clear lowest set bit
+	cursor.mask &= cursor.mask - 1;
+	
+	return index;
+}
+
+// force a kernel (SCAN_KERNEL_AUTO picks the best one supported), returns the kernel actually in use
+ScanKernel setScanKernel(ScanKernel kernel);
+ScanKernel getScanKernel();
+const char* getScanKernelName(ScanKernel kernel);
+
+#endif
@@ -0,0 +1,75 @@
+// sweep walkmap engine (subtracts every obstruction from a surface at once)
+
+#ifndef WALKMAP_SWEEP_H
+#define WALKMAP_SWEEP_H
+
+#include <walkmap.hpp>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+// axis aligned rectangle on the xz plane that belongs to an object
+struct SweepBox {
+	uint32_t owner;
+	
+	glm::vec2 low, high;
+};
+
+// an obstruction's z range starting (delta 1) or ending (delta -1) at x
+struct SweepEvent {
+	float x;
+	int32_t delta;
+	
+	// range of elementary z ranges the obstruction covers (indexes into SweepState::zs)
+	uint32_t low, high;
+};
+
+// scratch space reused by every subtraction
+struct SweepState {
+	std::vector<SweepEvent> events;
+	
+	// every z obstructions start or end at, the ranges between them are covered by a segment tree
+	std::vector<float> zs;
+	
+	// amount of obstructions covering all of each node, and if each node is covered entirely/at all
+	std::vector<uint32_t> cover;
+	std::vector<uint8_t> full;
+	std::vector<uint8_t> covered;
+	
+	// z ranges left free in the current slab
+	std::vector<glm::vec2> free;
+	
+	// boxes that are still being grown along x (sorted by z), and boxes closed and opened in the current slab
+	std::vector<uint32_t> open;
+	std::vector<uint32_t> stillOpen;
+	std::vector<uint32_t> closed;
+	std::vector<uint32_t> opened;
+	
+	// boxes of a surface bucketed into cells (cell i has cellBoxes[cellOffsets[i], cellOffsets[i+1])), to find the ones touching an obstruction
+	glm::vec2 gridOrigin;
+	glm::vec2 gridCellSize;
+	uint32_t gridWidth, gridDepth;
+	std::vector<uint32_t> cellOffsets;
+	std::vector<uint32_t> cellBoxes;
+	
+	// last query each box was found by
+	std::vector<uint32_t> boxStamps;
+	uint32_t query;
+};
+
+bool sweepBoxesTouch(const SweepBox& a, const SweepBox& b);
+
+// push the rectangles left of surface once the union of obstructions is taken out of it to boxes
+// rectangles that touch each other get linked (both ways)
+void subtractObstructions(SweepState* state, const SweepBox& surface, const std::vector<SweepBox>& obstructions, std::vector<SweepBox>& boxes, std::vector<std::pair<uint32_t, uint32_t>>& links);
+
+// bucket boxes[begin, end) into the state's grid, and push every one of them that touches area to found
+void buildSweepGrid(SweepState* state, const std::vector<SweepBox>& boxes, uint32_t begin, uint32_t end);
+void querySweepGrid(SweepState* state, const std::vector<SweepBox>& boxes, uint32_t begin, const SweepBox& area, std::vector<uint32_t>& found);
+
+void generateSweepWalkmap(WalkmapSettings& settings, const ObjectArrays* objects, CompactWalkmap* walkmap);
+
+#endif
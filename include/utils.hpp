@@ -6,8 +6,21 @@
 #include <cstdlib>
 #include <cstdint>
 #include <cfloat>
+#include <cstdio>
 
 #include <string>
+#include <string_view>
+#include <vector>
+
+// a file loaded into memory, either mapped directly (mmap) or read into a heap buffer
+struct FileBuffer {
+	// contents of the file (NOT null terminated when mapped, always use size)
+	const char* data;
+	size_t size;
+	
+	// true if data points to a memory mapping, false if it's a malloc'd buffer
+	bool mapped;
+};
 
 // allocate memory for a type and return the address for the allocated memory
 template <typename T>
@@ -23,10 +36,21 @@ template <typename T> int signum(T val) {
 
 // read the contents of a file and return a char buffer of the contents (free the buffer when done!)
 char* read_entire_file(const char* file);
+char* read_entire_file(FILE* source_file, size_t* size);
+
+// map a file into memory (falls back to read_entire_file for pipes and other unmappable files), returns NULL on failure
+FileBuffer* mapEntireFile(const char* file);
+void unmapEntireFile(FileBuffer* buffer);
+
+// 64 bit hash of a buffer (not cryptographic, only used to tell if a file has changed)
+uint64_t hashBuffer(const char* data, size_t size);
+
+// stable sort of indexes 0..count-1 by least to greatest key (LSD radix sort on the key's bits), ties keep index order
+void sortIndicesByKey(const float* keys, uint32_t count, std::vector<uint32_t>& sorted);
 
 bool nearly_equal(float a, float b);
 bool nearly_less_or_eq(float a, float b);
 bool nearly_greater_or_eq(float a, float b);
-bool isStringNumber(std::string& str);
+bool parseNumber(std::string_view str, float& out);
 
 #endif
\ No newline at end of file
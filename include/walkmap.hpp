@@ -9,11 +9,34 @@
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 
+#include <string>
+#include <string_view>
+#include <array>
 #include <vector>
 
 #define PROG_NAME "walkmap"
 #define PROG_VERSION "0.0-dev"
 
+// how walkable space is found
+enum WalkmapEngine {
+	WALKMAP_ENGINE_SPLIT = 0, // recursively split each object's box around the objects above it
+	WALKMAP_ENGINE_RASTER, // rasterize every height into cells and mesh them back into boxes
+	WALKMAP_ENGINE_SWEEP // subtract every object above each object from it at once with a sweep line
+};
+
+// how the split engine finds which boxes are adjacent
+enum WalkmapAdjacency {
+	WALKMAP_ADJACENCY_INCREMENTAL = 0, // pass adjacency on from each box to the boxes it's split into as it's split
+	WALKMAP_ADJACENCY_POST // link every pair of finished boxes that touch and can be stepped between
+};
+
+// how a box is split around an object that intersects it
+enum SplitStrategy {
+	SPLIT_STRATEGY_PINWHEEL = 0,
+	SPLIT_STRATEGY_ANVIL,
+	SPLIT_STRATEGY_AUTO
+};
+
 // settings struct
 struct WalkmapSettings {
 	const static uint32_t numSettings = 5; // not six because generateIds does not need to be written to walkmap + it's not a float
@@ -25,8 +48,70 @@ struct WalkmapSettings {
 	float heightSpeed; // not really a walkmap setting, but a world setting that makes sense to include here
 	
 	bool generateIds;
+	
+	// size of the cells in the broadphase grid (0 picks one from the scene)
+	float cellSize;
+	
+	SplitStrategy splitStrategy;
+	
+	// merge boxes that share a full edge and height once the walkmap is done
+	bool mergeBoxes;
+	
+	WalkmapEngine engine;
+	
+	// size of the cells used by the raster engine
+	float rasterResolution;
+	
+	// threads objects are processed on (0 uses every core), only used by the split engine
+	uint32_t threads;
+	
+	// smallest collision group a split box is handed to another thread for when there's more than one thread
+	uint32_t splitTaskCutoff;
+	
+	WalkmapAdjacency adjacency;
+};
+
+// bump allocator that boxes and everything in them come from, nothing is freed until the whole arena is
+struct BoxArena {
+	std::vector<char*> blocks;
+	
+	// bytes used in the last block
+	size_t used;
+};
+
+BoxArena* createBoxArena();
+void destroyBoxArena(BoxArena* arena);
+void* allocateFromArena(BoxArena* arena, size_t size, size_t alignment);
+
+// arena new boxes are created in on this thread
+void setBoxArena(BoxArena* arena);
+BoxArena* getBoxArena();
+
+// lets standard containers live in an arena (deallocating does nothing, the memory goes away with the arena)
+template <typename T> struct ArenaAllocator {
+	typedef T value_type;
+	
+	BoxArena* arena;
+	
+	ArenaAllocator(BoxArena* arena) : arena(arena) {}
+	template <typename U> ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+	
+	T* allocate(size_t n){ return (T*)allocateFromArena(arena, n * sizeof(T), alignof(T)); }
+	void deallocate(T*, size_t){}
+	
+	template <typename U> bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+	template <typename U> bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
 };
 
+struct BoundingBox;
+
+typedef std::vector<BoundingBox*, ArenaAllocator<BoundingBox*>> BoxAdjacency;
+
+// ids are copied into the arena too, see copyToArena
+typedef std::vector<std::string_view, ArenaAllocator<std::string_view>> BoxIds;
+
+std::string_view copyToArena(BoxArena* arena, std::string_view str);
+
 // 2d bounding box struct
 struct BoundingBox {
 	// position and size
@@ -37,39 +122,183 @@ struct BoundingBox {
 	glm::vec2 UL, UR, BL, BR;
 	
 	// adjacent bounding boxes
-	std::vector<BoundingBox*>* adjacent;
+	BoxAdjacency* adjacent;
 	
 	// if the bounding box is a result of a call to splitBbox, this int contains the position this bbox held in the newBoxes vector before being checked for adjacency (represents if it was box1, box2, etc.) (otherwise is -1)
 	// this is used to make adjacency recalculation as a result of a split faster, because bounding boxes at a certain position in a split are always adjacent to certain bounding boxes in the splitter, should the splitter be split (sorry for the tongue twister)
 	// none of the above is actually true, this was intended to be used for that purpose but ended up being used to keep track of the index when writing the walkmap to a file
 	//int32_t splitIndex;
 	
-	// is this bbox reachable, used in pushBboxes and deleteUnreachable to determine where the object is reached, and then afterward in walkmapToBuffer as an adjacency index
+	// index of the box in the compacted walkmap (see compactWalkmap)
 	int32_t reachable;
 	
-	std::vector<std::string>* ids;
+	BoxIds* ids;
 };
 
-void processObject(Object* owner, std::vector<BoundingBox*>* bboxes, std::vector<Object*>* scene, std::vector<uint32_t>* sortedByHeight, uint32_t heightIndex, WalkmapSettings& settings);
-void pushBboxes(BoundingBox* bbox);
-void pushBboxesNoRecurse(BoundingBox* bbox);
-void deleteUnreachable(std::vector<BoundingBox*>* bboxes);
-void generateWalkmap(WalkmapSettings& settings, std::vector<Object*>* objects, std::vector<BoundingBox*>* finalWalkmap);
-void walkmapToBuffer(std::string& buffer, std::vector<BoundingBox*>* walkmap, WalkmapSettings& settings);
-void walkmapToWorld(std::string& buffer, std::vector<BoundingBox*>* walkmap, WalkmapSettings& settings);
+// uniform grid over object footprints (xz), used to only check objects near a box instead of every object above it
+// objects are only added to their cells once they're close enough above the object being processed to matter (see activateObjects), and removed once they've been processed
+struct ObjectGrid {
+	glm::vec2 origin;
+	float cellSize;
+	uint32_t width;
+	uint32_t depth;
+	
+	// queries are grown by this much so that boxes bboxIntersection counts as touching are always found
+	float padding;
+	
+	// first and last cell (inclusive) of each object, by height position (index into sortedByHeight)
+	std::vector<glm::uvec2> firstCells;
+	std::vector<glm::uvec2> lastCells;
+	
+	// height positions of the active objects overlapping each cell (unordered)
+	std::vector<std::vector<uint32_t>> cells;
+};
+
+// boxes a split produces, there are never more than 4 so they don't need a vector
+struct SplitResult {
+	std::array<BoundingBox*, 4> boxes;
+	
+	// amount of boxes (1 if the original was returned, 4 otherwise)
+	uint32_t count;
+	
+	// bit i is set if boxes[i] exists (splits can produce empty boxes, which are dropped)
+	uint32_t live;
+};
+
+inline bool isSplitBoxLive(const SplitResult& split, uint32_t i){
+	return split.live & (1 << i);
+}
+
+// finished walkmap box, the values written to a .walkmap file and indexes instead of pointers
+struct CompactBox {
+	// center (y is the height of the walkable surface) and size
+	float x, y, z;
+	float width, depth;
+	
+	// range of the box's ids in CompactWalkmap::ids
+	uint32_t idStart;
+	uint32_t idCount;
+};
+
+// finished walkmap, with adjacency stored as CSR (box i is adjacent to edges[offsets[i], offsets[i+1]))
+struct CompactWalkmap {
+	std::vector<CompactBox> boxes;
+	
+	std::vector<uint32_t> offsets = {0};
+	std::vector<uint32_t> edges;
+	
+	// every id of every box as an offset + length in idPool
+	std::vector<std::pair<uint32_t, uint32_t>> ids;
+	std::string idPool;
+};
+
+// adds a box with no adjacent boxes, returns its index
+uint32_t addCompactBox(CompactWalkmap* walkmap, glm::vec3 position, glm::vec2 size);
+std::string_view getCompactBoxId(const CompactWalkmap* walkmap, uint32_t box, uint32_t id);
+void compactWalkmap(std::vector<BoundingBox*>* boxes, CompactWalkmap* walkmap);
+void markReachable(const CompactWalkmap* walkmap, uint32_t start, std::vector<bool>& reachable);
+void removeUnreachable(CompactWalkmap* walkmap, const std::vector<bool>& reachable);
+void mergeBoxes(CompactWalkmap* walkmap);
+void linkCompactBoxes(CompactWalkmap* walkmap, float stepHeight);
+
+// state of a walkmap being generated, per object vectors are indexed the same as the scene's objects
+struct WalkmapGenerator {
+	const ObjectArrays* objects;
+	WalkmapSettings settings;
+	
+	// object indexes sorted by least to greatest top face height
+	std::vector<uint32_t> sortedByHeight;
+	
+	// bottom face heights in the same order as sortedByHeight
+	std::vector<float> bottomsByHeight;
+	
+	// height positions sorted by least to greatest bottom face height, objects are activated in this order
+	std::vector<uint32_t> sortedByBottom;
+	uint32_t activated;
+	
+	// height position of the object being processed
+	uint32_t processing;
+	
+	// boxes of each object (an object only has one box until it's processed)
+	std::vector<std::vector<BoundingBox*>> bboxes;
+	
+	// object can be stepped onto from an object below it
+	std::vector<bool> reachable;
+	
+	ObjectGrid grid;
+	
+	// last query each height position was found by, so objects in more than one cell are only returned once
+	std::vector<uint32_t> queryStamps;
+	uint32_t query;
+};
+
+// split made by processObject, kept so the links it makes to other objects' boxes can be made later (see linkSplit)
+struct SplitEvent {
+	BoundingBox* original;
+	
+	// object the box was split by
+	uint32_t splitter;
+	
+	SplitResult result;
+};
+
+// boxes processObject still has to go through, bboxes[next, end) are checked against groupStack[groupBegin, groupEnd)
+struct ProcessFrame {
+	uint32_t next, end;
+	uint32_t groupBegin, groupEnd;
+};
+
+// state of whatever is processing objects, every thread gets its own
+struct WalkmapWorker {
+	// collision groups of the object being processed and the boxes it's been split into, each split pushes its (narrower) group on top
+	std::vector<uint32_t> groupStack;
+	
+	// boxes processObject has yet to process, newest split on top
+	std::vector<ProcessFrame> frames;
+	
+	// last query each height position was found by (only used by querySharedObjectGrid)
+	std::vector<uint32_t> queryStamps;
+	uint32_t query = 0;
+	
+	// if not NULL, splits are appended here instead of being linked, so nothing outside of the object being processed is touched
+	std::vector<SplitEvent>* splits = NULL;
+};
+
+void initializeGenerator(WalkmapGenerator* generator, const WalkmapSettings& settings, const ObjectArrays* objects);
+void buildObjectGrid(WalkmapGenerator* generator);
+void activateObjects(WalkmapGenerator* generator, float top);
+void narrowCollisionGroup(const WalkmapGenerator* generator, WalkmapWorker* worker, BoundingBox* box, uint32_t groupBegin, uint32_t groupEnd);
+void queryObjectGrid(WalkmapGenerator* generator, BoundingBox* box, uint32_t heightIndex, std::vector<uint32_t>& candidates);
+void querySharedObjectGrid(const WalkmapGenerator* generator, WalkmapWorker* worker, BoundingBox* box, uint32_t heightIndex, float top, std::vector<uint32_t>& candidates);
+
+void processObject(WalkmapGenerator* generator, WalkmapWorker* worker, uint32_t owner, std::vector<BoundingBox*>* bboxes, uint32_t begin, uint32_t end, uint32_t groupBegin, uint32_t groupEnd);
+void linkSplit(WalkmapGenerator* generator, BoundingBox* original, uint32_t object, const SplitResult* split);
+void generateWalkmap(WalkmapSettings& settings, const ObjectArrays* objects, CompactWalkmap* finalWalkmap);
+void finishWalkmap(WalkmapSettings& settings, CompactWalkmap* walkmap);
+void walkmapToBuffer(std::string& buffer, const CompactWalkmap* walkmap, WalkmapSettings& settings);
+void walkmapToWorld(std::string& buffer, const CompactWalkmap* walkmap, WalkmapSettings& settings);
 
 BoundingBox* createBbox(glm::vec2 p, glm::vec2 s);
 BoundingBox* createBbox(glm::vec3 p, glm::vec2 s);
 BoundingBox* createBbox(BoundingBox* original);
-BoundingBox* objToBbox(Object* obj);
+BoundingBox* objToBbox(const ObjectArrays* objects, uint32_t index);
+
+// corners of an object's footprint (the same area objToBbox covers)
+inline void getObjectFootprint(const ObjectArrays* objects, uint32_t index, glm::vec2& low, glm::vec2& high){
+	glm::vec2 position = glm::vec2(objects->positions[index].x, objects->positions[index].z);
+	glm::vec2 halfSize = glm::vec2(objects->scales[index].x, objects->scales[index].z) / 2.f;
+	
+	low = position - halfSize;
+	high = position + halfSize;
+}
 void generateBboxCorners(BoundingBox* box);
-void destroyBbox(BoundingBox* b);
 bool bboxIntersection(glm::vec2 p1, glm::vec2 s1, glm::vec2 p2, glm::vec2 s2);
 bool bboxIntersection(BoundingBox* b1, BoundingBox* b2);
 void markAdjacent(BoundingBox* b1, BoundingBox* b2);
 void moveBbox(BoundingBox* original, glm::vec3 newPosition);
 void resizeBbox(BoundingBox* original, glm::vec2 newSize);
 void moveAndResizeBbox(BoundingBox* original, glm::vec3 newPosition, glm::vec2 newSize);
-void splitBbox(std::vector<BoundingBox*>* newBoxes, BoundingBox* original, BoundingBox* splitter);
+void splitBbox(SplitResult* newBoxes, BoundingBox* original, BoundingBox* splitter, SplitStrategy strategy = SPLIT_STRATEGY_PINWHEEL);
+void linkSplitBoxes(const SplitResult* split);
 
 #endif
\ No newline at end of file
@@ -4,64 +4,110 @@
 #define WALKMAP_WORLD_H
 
 // includes //
+#include <cstdio>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <map>
+#include <deque>
+#include <unordered_map>
 #include <utility>
 
 #include <glm/glm.hpp>
 
 // structs //
 
-// declare bounding box here so that we can use pointers to it
-struct BoundingBox;
+// objects, stored as a structure of arrays (index i of every array belongs to object i) so passes over every object stay contiguous
+struct ObjectArrays {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> rotations;
+	std::vector<glm::vec3> scales;
+	
+	// heights of the top and bottom faces (position.y +- scale.y/2)
+	std::vector<float> tops;
+	std::vector<float> bottoms;
+	
+	// range of the object's ids in ids
+	std::vector<uint32_t> idStarts;
+	std::vector<uint32_t> idCounts;
+	
+	// every id of every object as an offset + length in idPool
+	std::vector<std::pair<uint32_t, uint32_t>> ids;
+	std::string idPool;
+};
 
-// object
-struct Object {
-	glm::vec3 position;
-	glm::vec3 rotation;
-	glm::vec3 scale;
+// parser statistics
+struct ParseStats {
+	// blocks handed to a block parser
+	size_t blocksParsed = 0;
 	
-	std::vector<BoundingBox*>* bboxes;
+	// blocks the walkmap doesn't need (textures, lights, audio, triggers, settings) and the bytes inside of them that were skipped
+	size_t blocksSkipped = 0;
+	size_t bytesSkipped = 0;
 	
-	bool reachable;
+	// scene was loaded from a compiled .worldc cache instead of being parsed
+	bool fromCache = false;
+};
+
+// model names interned into dense ids, bounds are stored in flat arrays indexed by id
+struct ModelTable {
+	// deque so names never move, the keys of ids are views of them
+	std::deque<std::string> names;
+	std::unordered_map<std::string_view, uint32_t> ids;
 	
-	std::vector<std::string>* ids;
+	std::vector<glm::vec3> offsets;
+	std::vector<glm::vec3> sizes;
 	
-	int32_t children;
+	// false for names an object used before (or without) any vertex data defining them
+	std::vector<bool> defined;
 };
 
 // scene
 struct Scene {
-	std::vector<Object*>* objects;
+	ObjectArrays* objects;
 	
-	std::map<std::string, std::pair<glm::vec3, glm::vec3>>* modelSizes;
+	ModelTable* models;
+	
+	ParseStats stats;
 };
 
 // parsing block
+// all strings are slices of the file buffer being parsed, so a block is only valid until the buffer is released
 struct Block {
 	// vector of ids
-	std::vector<std::string>* ids;
+	std::vector<std::string_view> ids;
 	
 	// vector for string parameters
-	std::vector<std::string>* strings;
+	std::vector<std::string_view> strings;
 	
 	// vector for num parameters (always floats)
-	std::vector<float>* numbers;
+	std::vector<float> numbers;
 	
 	// index of parameter being written to
 	uint32_t parameterIndex;
-	
-	// string buffer for parameter
-	std::string* parameterBuffer;
 };
 
 
 // methods //
-Object* createEmptyObject();
-Object* createObject(glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, std::vector<std::string>* ids);
+uint32_t addObject(ObjectArrays* objects, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, const std::string_view* ids, uint32_t idCount);
+uint32_t appendObject(ObjectArrays* objects, const ObjectArrays* from, uint32_t index);
+void setObjectTransform(ObjectArrays* objects, uint32_t index, glm::vec3 position, glm::vec3 scale);
+std::string_view getObjectId(const ObjectArrays* objects, uint32_t object, uint32_t id);
+bool resolveObjectModel(glm::vec3& position, glm::vec3 rotation, glm::vec3& scale, uint32_t model, const ModelTable* models);
+
+// returns the id of a model name, adding it (undefined) if it isn't in the table yet
+uint32_t internModel(ModelTable* models, std::string_view name);
+void defineModel(ModelTable* models, std::string_view name, glm::vec3 offset, glm::vec3 size);
+
+Scene* createScene();
+void destroyScene(Scene* scene);
+
+// threads = 0 uses every core available, 1 parses on the calling thread
+// cache loads/writes a compiled copy of the world next to it (file + "c"), keyed by a hash of the file's contents
+Scene* parseWorld(const char* file, uint32_t threads = 1, bool cache = true);
+bool parseWorldIntoScene(Scene* scene, const char* file, uint32_t threads = 1, bool cache = true);
+void parseWorldBuffer(Scene* scene, const char* data, size_t size, uint32_t threads = 1);
 
-Scene* parseWorld(const char* file);
-bool parseWorldIntoScene(Scene* scene, const char* file);
+// parses a stream in fixed size chunks with bounded memory (used for "-" as a file), never cached
+bool parseWorldStream(Scene* scene, FILE* stream);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+// compiled scene cache (.worldc), a binary copy of a parsed scene that can be loaded with a single mmap
+
+#ifndef WALKMAP_WORLDCACHE_H
+#define WALKMAP_WORLDCACHE_H
+
+#include <world.hpp>
+
+#include <cstdint>
+#include <string>
+
+// bump whenever the layout below or the way objects are parsed changes, old caches are then ignored
+#define SCENE_CACHE_VERSION 1
+
+// file layout (native byte order, everything is 4 byte aligned):
+//   SceneCacheHeader
+//   SceneCacheModel[modelCount]
+//   SceneCacheObject[objectCount]
+//   SceneCacheString[idCount]
+//   char[stringBytes] (model names + ids, not null terminated)
+struct SceneCacheHeader {
+	char magic[4];
+	uint32_t version;
+	
+	// hash + size of the .world file the cache was compiled from
+	uint64_t sourceHash;
+	uint64_t sourceSize;
+	
+	uint32_t modelCount;
+	uint32_t objectCount;
+	uint32_t idCount;
+	uint32_t stringBytes;
+};
+
+struct SceneCacheString {
+	uint32_t offset;
+	uint32_t length;
+};
+
+struct SceneCacheModel {
+	float offset[3];
+	float size[3];
+	
+	SceneCacheString name;
+};
+
+struct SceneCacheObject {
+	float position[3];
+	float rotation[3];
+	float scale[3];
+	
+	// range in the id table
+	uint32_t idStart;
+	uint32_t idCount;
+};
+
+// path of the cache for a .world file (written next to it)
+std::string getSceneCachePath(const char* file);
+
+// load a cache into a scene if it was compiled from a source with the same hash + size, returns false if it's missing, stale or broken
+bool loadSceneCache(Scene* scene, const char* path, uint64_t sourceHash, uint64_t sourceSize);
+
+// write the objects starting at firstObject (and every model) to a cache
+bool writeSceneCache(Scene* scene, uint32_t firstObject, const char* path, uint64_t sourceHash, uint64_t sourceSize);
+
+#endif
@@ -38,18 +38,74 @@ int main(int argc, char** argv){
 		exit(EXIT_FAILURE);
 	}
 	
+	// check split strategy before spending any time parsing
+	std::string splitStrategyArg = argParser.get<std::string>("--split-strategy");
+	SplitStrategy splitStrategy;
+	
+	if(splitStrategyArg == "pinwheel"){
+		splitStrategy = SPLIT_STRATEGY_PINWHEEL;
+	} else if(splitStrategyArg == "anvil"){
+		splitStrategy = SPLIT_STRATEGY_ANVIL;
+	} else if(splitStrategyArg == "auto"){
+		splitStrategy = SPLIT_STRATEGY_AUTO;
+	} else {
+		std::cerr << "Unknown split strategy: " << splitStrategyArg << " (expected pinwheel, anvil or auto)" << std::endl;
+		
+		exit(EXIT_FAILURE);
+	}
+	
+	std::string adjacencyArg = argParser.get<std::string>("--adjacency");
+	WalkmapAdjacency adjacency;
+	
+	if(adjacencyArg == "incremental"){
+		adjacency = WALKMAP_ADJACENCY_INCREMENTAL;
+	} else if(adjacencyArg == "post"){
+		adjacency = WALKMAP_ADJACENCY_POST;
+	} else {
+		std::cerr << "Unknown adjacency mode: " << adjacencyArg << " (expected incremental or post)" << std::endl;
+		
+		exit(EXIT_FAILURE);
+	}
+	
+	std::string engineArg = argParser.get<std::string>("--engine");
+	WalkmapEngine engine;
+	
+	if(engineArg == "split"){
+		engine = WALKMAP_ENGINE_SPLIT;
+	} else if(engineArg == "raster"){
+		engine = WALKMAP_ENGINE_RASTER;
+	} else if(engineArg == "sweep"){
+		engine = WALKMAP_ENGINE_SWEEP;
+	} else {
+		std::cerr << "Unknown engine: " << engineArg << " (expected split, raster or sweep)" << std::endl;
+		
+		exit(EXIT_FAILURE);
+	}
+	
+	if(argParser.get<float>("--raster-resolution") <= 0){
+		std::cerr << "--raster-resolution has to be greater than 0" << std::endl;
+		
+		exit(EXIT_FAILURE);
+	}
+	
 	// get file path
 	std::string path = argParser.get<std::string>("--world");
 	
 	printf("Parsing .world file...\n");
 	
 	// load world
-	Scene* world = parseWorld(path.c_str());
+	Scene* world = parseWorld(path.c_str(), argParser.get<uint32_t>("--parse-threads"), !argParser.get<bool>("--no-cache"));
 	
 	if(world == NULL){
 		exit(EXIT_FAILURE);
 	}
 	
+	if(world->stats.fromCache){
+		printf(" - Loaded from scene cache\n");
+	} else {
+		printf(" - Parsed %zu blocks, skipped %zu blocks (%zu bytes) the walkmap doesn't need\n", world->stats.blocksParsed, world->stats.blocksSkipped, world->stats.bytesSkipped);
+	}
+	
 	// create walkmap from settings
 	
 	// load settings
@@ -61,6 +117,14 @@ int main(int argc, char** argv){
 	settings.maxPlayerSpeed = argParser.get<float>("--player-max-speed");
 	settings.heightSpeed = argParser.get<float>("--height-adjustment-speed");
 	settings.generateIds = argParser.get<bool>("--generate-walkbox-ids");
+	settings.cellSize = argParser.get<float>("--cell-size");
+	settings.splitStrategy = splitStrategy;
+	settings.mergeBoxes = argParser.get<bool>("--merge-boxes");
+	settings.engine = engine;
+	settings.rasterResolution = argParser.get<float>("--raster-resolution");
+	settings.threads = argParser.get<uint32_t>("--threads");
+	settings.splitTaskCutoff = argParser.get<uint32_t>("--split-task-cutoff");
+	settings.adjacency = adjacency;
 	
 	std::string buffer;
 	std::string outPath = argParser.get<std::string>("--walkmap");
@@ -68,13 +132,13 @@ int main(int argc, char** argv){
 	
 	bool generateWalkmapArg = !argParser.get<bool>("--no-walkmap");
 	
-	std::vector<BoundingBox*> walkmap;
+	CompactWalkmap walkmap;
 	
 	if(generateWalkmapArg){
 		// resize all objects indiscriminately
-		for(uint32_t i = 0; i < world->objects->size(); i++){
-			world->objects->at(i)->scale.x += settings.playerRadius;
-			world->objects->at(i)->scale.z += settings.playerRadius;
+		for(glm::vec3& scale : world->objects->scales){
+			scale.x += settings.playerRadius;
+			scale.z += settings.playerRadius;
 		}
 		
 		printf("Generating walkmap...\n");
@@ -105,13 +169,13 @@ int main(int argc, char** argv){
 		buffer = "";
 		
 		if(noWalkmap){
-			walkmap.clear();
+			walkmap = CompactWalkmap();
 			
 			// adapt walkmap into bounding boxes
-			for(uint32_t i = 0; i < world->objects->size(); i++){
-				Object* object = world->objects->at(i);
+			for(uint32_t i = 0; i < world->objects->positions.size(); i++){
+				glm::vec3 scale = world->objects->scales[i];
 				
-				walkmap.push_back( createBbox(object->position, glm::vec2(object->scale.x, object->scale.z) ) );
+				addCompactBox(&walkmap, world->objects->positions[i], glm::vec2(scale.x, scale.z));
 			}
 		}
 		
@@ -124,6 +188,8 @@ int main(int argc, char** argv){
 		out.close();
 	}
 	
+	destroyScene(world);
+	
 	// get time elapsed
 	std::chrono::system_clock::time_point end = std::chrono::system_clock::now();
 	std::chrono::duration<double> elapsed = end-start;
@@ -139,7 +205,7 @@ void initializeArguments(argparse::ArgumentParser& parser){
 	
 	// arguments
 	parser.add_argument("--in", "--world")
-		.help("path to a .world file (or .walkmap file, if only generating a walkmap .world) to generate walkmap for")
+		.help("path to a .world file (or .walkmap file, if only generating a walkmap .world) to generate walkmap for, - reads it from stdin")
 		.required()
 		.append();
 		
@@ -147,6 +213,16 @@ void initializeArguments(argparse::ArgumentParser& parser){
 		.help("where to output the walkmap + walkmap.world file")
 		.append();
 	
+	parser.add_argument("--parse-threads")
+		.help("amount of threads to parse the .world file with (0 uses every core).  large worlds are split into chunks at block boundaries and parsed in parallel, the result is the same as parsing on one thread.")
+		.default_value<uint32_t>(1)
+		.scan<'u', uint32_t>();
+	
+	parser.add_argument("--no-cache")
+		.help("don't load or write the compiled scene cache (.worldc) next to the .world file.  by default the cache is used whenever the .world file hasn't changed since it was written.")
+		.default_value(false)
+		.implicit_value(true);
+	
 	parser.add_argument("--player-height")
 		.help("used to determine if objects will obstruct the player's walkable space or not.  overrides any value present in the .world file.")
 		.default_value<float>(2.f)
@@ -167,6 +243,43 @@ void initializeArguments(argparse::ArgumentParser& parser){
 		.default_value<float>(2.f)
 		.scan<'g', float>();
 		
+	parser.add_argument("--cell-size")
+		.help("size of the cells used to find objects near each other when generating the walkmap.  0 picks a size based on the objects in the world.")
+		.default_value<float>(0.f)
+		.scan<'g', float>();
+	
+	parser.add_argument("--engine")
+		.help("how walkable space is found.  split recursively splits each object around the objects above it, raster rasterizes each height into cells and meshes the free cells back into boxes (faster for cluttered scenes, but box edges snap to the cells), sweep subtracts every object above each object from it at once with a sweep line.")
+		.default_value<std::string>("split");
+	
+	parser.add_argument("--raster-resolution")
+		.help("size of the cells used by the raster engine.  smaller cells follow objects more closely but use more memory and time.")
+		.default_value<float>(0.5f)
+		.scan<'g', float>();
+	
+	parser.add_argument("--split-strategy")
+		.help("how boxes are split around objects that intersect them.  pinwheel gives each box one corner of the object, anvil uses full width strips above and below it with short pieces on its sides, auto uses anvil only for splits where it leaves less boxes than pinwheel.")
+		.default_value<std::string>("pinwheel");
+	
+	parser.add_argument("--threads")
+		.help("amount of threads to generate the walkmap with (0 uses every core).  only the default (split) engine uses more than one, the walkmap is the same no matter how many threads it's generated on.")
+		.default_value<uint32_t>(1)
+		.scan<'u', uint32_t>();
+	
+	parser.add_argument("--split-task-cutoff")
+		.help("when generating on more than one thread, boxes that have at least this many objects that could split them are processed as tasks of their own that any thread can take (so one object with a lot on top of it doesn't hold up one thread).  smaller boxes are processed by whatever thread split them.")
+		.default_value<uint32_t>(32)
+		.scan<'u', uint32_t>();
+	
+	parser.add_argument("--adjacency")
+		.help("how the split engine finds adjacent boxes.  incremental passes each box's adjacency on to the boxes it's split into, post skips that and links every pair of finished boxes that touch and are within the step height of each other in one pass at the end (faster when boxes have a lot of neighbors).")
+		.default_value<std::string>("incremental");
+	
+	parser.add_argument("--merge-boxes")
+		.help("merge boxes that have the same height and share a full edge into larger boxes once the walkmap is generated (less boxes to write and look through at runtime).")
+		.default_value(false)
+		.implicit_value(true);
+	
 	parser.add_argument("--height-adjustment-speed")
 		.help("not really used by the walkmap generator at all, but if it's not defined in the .world file you can use this to set it to something other than default.")
 		.default_value<float>(10.f)
@@ -0,0 +1,358 @@
+// raster walkmap engine
+#include <raster.hpp>
+#include <utils.hpp>
+
+#include <algorithm>
+#include <ctgmath>
+#include <cstdio>
+#include <string>
+
+// cells whose centers are inside of an area (walkable surfaces only cover the cells they mostly cover)
+static inline void getCoveredCells(glm::vec2 low, glm::vec2 high, float resolution, glm::ivec2& first, glm::ivec2& last){
+	first = glm::ivec2( glm::ceil(low / resolution - 0.5f) );
+	last = glm::ivec2( glm::floor(high / resolution - 0.5f) );
+}
+
+// cells an area overlaps at all (obstructions block every cell they get into)
+static inline void getTouchedCells(glm::vec2 low, glm::vec2 high, float resolution, glm::ivec2& first, glm::ivec2& last){
+	first = glm::ivec2( glm::floor(low / resolution) );
+	last = glm::ivec2( glm::ceil(high / resolution) ) - 1;
+}
+
+uint32_t getLayerBox(const RasterLayer* layer, int32_t x, int32_t z){
+	x -= layer->origin.x;
+	z -= layer->origin.y;
+	
+	if(x < 0 || z < 0 || x >= (int32_t)layer->width || z >= (int32_t)layer->depth) return UINT32_MAX;
+	
+	return layer->boxes[(size_t)z * layer->width + x];
+}
+
+void rasterizeLayer(WalkmapGenerator* generator, RasterLayer* layer, uint32_t begin, uint32_t end){
+	const ObjectArrays* objects = generator->objects;
+	float resolution = generator->settings.rasterResolution;
+	
+	layer->height = objects->tops[generator->sortedByHeight[begin]];
+	
+	// bounds of every surface in the layer
+	glm::ivec2 first = glm::ivec2(INT32_MAX);
+	glm::ivec2 last = glm::ivec2(INT32_MIN);
+	
+	for(uint32_t j = begin; j < end; j++){
+		glm::vec2 low, high;
+		getObjectFootprint(objects, generator->sortedByHeight[j], low, high);
+		
+		glm::ivec2 objectFirst, objectLast;
+		getCoveredCells(low, high, resolution, objectFirst, objectLast);
+		
+		// too small to cover a cell
+		if(objectFirst.x > objectLast.x || objectFirst.y > objectLast.y) continue;
+		
+		first = glm::min(first, objectFirst);
+		last = glm::max(last, objectLast);
+	}
+	
+	if(first.x > last.x){
+		layer->origin = glm::ivec2(0);
+		layer->width = 0;
+		layer->depth = 0;
+		
+		return;
+	}
+	
+	layer->origin = first;
+	layer->width = last.x - first.x + 1;
+	layer->depth = last.y - first.y + 1;
+	
+	layer->owners.assign((size_t)layer->width * layer->depth, UINT32_MAX);
+	
+	// surfaces later in height order cover earlier ones (like they'd split them)
+	for(uint32_t j = begin; j < end; j++){
+		uint32_t object = generator->sortedByHeight[j];
+		
+		glm::vec2 low, high;
+		getObjectFootprint(objects, object, low, high);
+		
+		glm::ivec2 objectFirst, objectLast;
+		getCoveredCells(low, high, resolution, objectFirst, objectLast);
+		
+		for(int32_t z = objectFirst.y; z <= objectLast.y; z++){
+			uint32_t* row = layer->owners.data() + (size_t)(z - first.y) * layer->width;
+			
+			for(int32_t x = objectFirst.x; x <= objectLast.x; x++){
+				row[x - first.x] = object;
+			}
+		}
+	}
+	
+	// block everything under objects whose bottom face is less than the player height above the layer
+	generator->processing = end - 1;
+	activateObjects(generator, layer->height);
+	
+	glm::vec2 boundsLow = glm::vec2(first) * resolution;
+	glm::vec2 boundsHigh = glm::vec2(last + 1) * resolution;
+	
+	BoundingBox bounds;
+	bounds.position = glm::vec3((boundsLow.x + boundsHigh.x) / 2.f, layer->height, (boundsLow.y + boundsHigh.y) / 2.f);
+	bounds.size = boundsHigh - boundsLow;
+	
+	std::vector<uint32_t> candidates;
+	queryObjectGrid(generator, &bounds, end, candidates);
+	
+	for(uint32_t j : candidates){
+		glm::vec2 low, high;
+		getObjectFootprint(objects, generator->sortedByHeight[j], low, high);
+		
+		glm::ivec2 objectFirst, objectLast;
+		getTouchedCells(low, high, resolution, objectFirst, objectLast);
+		
+		objectFirst = glm::max(objectFirst, first);
+		objectLast = glm::min(objectLast, last);
+		
+		for(int32_t z = objectFirst.y; z <= objectLast.y; z++){
+			uint32_t* row = layer->owners.data() + (size_t)(z - first.y) * layer->width;
+			
+			for(int32_t x = objectFirst.x; x <= objectLast.x; x++){
+				row[x - first.x] = UINT32_MAX;
+			}
+		}
+	}
+}
+
+void meshLayer(RasterLayer* layer, uint32_t layerIndex, std::vector<RasterBox>& boxes){
+	const std::vector<uint32_t>& owners = layer->owners;
+	std::vector<uint32_t>& meshed = layer->boxes;
+	
+	meshed.assign(owners.size(), UINT32_MAX);
+	
+	uint32_t width = layer->width;
+	
+	for(uint32_t z = 0; z < layer->depth; z++){
+		for(uint32_t x = 0; x < width; x++){
+			size_t cell = (size_t)z * width + x;
+			uint32_t owner = owners[cell];
+			
+			if(owner == UINT32_MAX || meshed[cell] != UINT32_MAX) continue;
+			
+			// grow along the row as far as possible, then grow the whole row down as far as possible
+			uint32_t boxWidth = 1;
+			
+			while(x + boxWidth < width && owners[cell + boxWidth] == owner && meshed[cell + boxWidth] == UINT32_MAX){
+				boxWidth++;
+			}
+			
+			uint32_t boxDepth = 1;
+			
+			while(z + boxDepth < layer->depth){
+				size_t row = cell + (size_t)boxDepth * width;
+				bool fits = true;
+				
+				for(uint32_t k = 0; k < boxWidth; k++){
+					if(owners[row + k] != owner || meshed[row + k] != UINT32_MAX){
+						fits = false;
+						break;
+					}
+				}
+				
+				if(!fits) break;
+				
+				boxDepth++;
+			}
+			
+			uint32_t index = boxes.size();
+			
+			for(uint32_t m = 0; m < boxDepth; m++){
+				std::fill_n(meshed.begin() + cell + (size_t)m * width, boxWidth, index);
+			}
+			
+			RasterBox box;
+			box.layer = layerIndex;
+			box.owner = owner;
+			box.first = layer->origin + glm::ivec2(x, z);
+			box.last = box.first + glm::ivec2(boxWidth - 1, boxDepth - 1);
+			
+			boxes.push_back(box);
+		}
+	}
+	
+	// owners aren't needed once the layer is meshed
+	layer->owners.clear();
+	layer->owners.shrink_to_fit();
+}
+
+// part of a box's owner around the box: its cells grown by the 2 cells step links are looked for in, clipped to the owner's footprint
+static void getRasterBoxFootprint(const ObjectArrays* objects, const RasterBox& box, float resolution, glm::vec2& low, glm::vec2& high){
+	getObjectFootprint(objects, box.owner, low, high);
+	
+	low = glm::max(low, glm::vec2(box.first - 2) * resolution);
+	high = glm::min(high, glm::vec2(box.last + 3) * resolution);
+}
+
+void linkRasterBoxes(WalkmapGenerator* generator, const std::vector<RasterLayer>& layers, const std::vector<RasterBox>& boxes, std::vector<std::pair<uint32_t, uint32_t>>& links){
+	float stepHeight = generator->settings.stepHeight;
+	
+	// footprints step links are checked with
+	std::vector<glm::vec2> lows(boxes.size()), highs(boxes.size());
+	
+	for(uint32_t b = 0; b < boxes.size(); b++){
+		getRasterBoxFootprint(generator->objects, boxes[b], generator->settings.rasterResolution, lows[b], highs[b]);
+	}
+	
+	for(uint32_t l = 0; l < layers.size(); l++){
+		const RasterLayer& layer = layers[l];
+		const std::vector<uint32_t>& meshed = layer.boxes;
+		
+		// boxes in the layer that share an edge (boxes are rectangles, so each edge is only linked from its first cell)
+		for(uint32_t z = 0; z < layer.depth; z++){
+			for(uint32_t x = 0; x < layer.width; x++){
+				size_t cell = (size_t)z * layer.width + x;
+				uint32_t box = meshed[cell];
+				
+				if(box == UINT32_MAX) continue;
+				
+				if(x+1 < layer.width){
+					uint32_t right = meshed[cell + 1];
+					
+					bool linked = z > 0 && meshed[cell - layer.width] == box && meshed[cell - layer.width + 1] == right;
+					
+					if(right != UINT32_MAX && right != box && !linked){
+						links.push_back(std::make_pair(box, right));
+						links.push_back(std::make_pair(right, box));
+					}
+				}
+				
+				if(z+1 < layer.depth){
+					uint32_t below = meshed[cell + layer.width];
+					
+					bool linked = x > 0 && meshed[cell - 1] == box && meshed[cell - 1 + layer.width] == below;
+					
+					if(below != UINT32_MAX && below != box && !linked){
+						links.push_back(std::make_pair(box, below));
+						links.push_back(std::make_pair(below, box));
+					}
+				}
+			}
+		}
+		
+		// boxes in higher layers that can be stepped onto from this one
+		// the edges of a surface and of the space it blocks below it can be up to a cell apart, so boxes up to 2 cells apart are candidates, and are only linked if their footprints really touch
+		for(uint32_t u = l+1; u < layers.size() && nearly_less_or_eq(layers[u].height - layer.height, stepHeight); u++){
+			const RasterLayer* from = &layer;
+			const RasterLayer* to = &layers[u];
+			
+			// look from the smaller layer into the larger one
+			if((size_t)from->width * from->depth > (size_t)to->width * to->depth) std::swap(from, to);
+			
+			for(uint32_t z = 0; z < from->depth; z++){
+				for(uint32_t x = 0; x < from->width; x++){
+					uint32_t box = from->boxes[(size_t)z * from->width + x];
+					
+					if(box == UINT32_MAX) continue;
+					
+					int32_t cellX = from->origin.x + x;
+					int32_t cellZ = from->origin.y + z;
+					
+					for(int32_t dz = -2; dz <= 2; dz++){
+						for(int32_t dx = -2; dx <= 2; dx++){
+							uint32_t other = getLayerBox(to, cellX + dx, cellZ + dz);
+							
+							if(other == UINT32_MAX) continue;
+							
+							if(!bboxIntersection((lows[box] + highs[box]) / 2.f, highs[box] - lows[box], (lows[other] + highs[other]) / 2.f, highs[other] - lows[other])) continue;
+							
+							links.push_back(std::make_pair(box, other));
+							links.push_back(std::make_pair(other, box));
+						}
+					}
+				}
+			}
+		}
+	}
+	
+	std::sort(links.begin(), links.end());
+	links.erase( std::unique(links.begin(), links.end()), links.end() );
+}
+
+// generate walkmap by rasterizing each height into cells
+void generateRasterWalkmap(WalkmapSettings& settings, const ObjectArrays* objects, CompactWalkmap* walkmap){
+	uint32_t objectCount = objects->positions.size();
+	
+	WalkmapGenerator generator;
+	initializeGenerator(&generator, settings, objects);
+	
+	const std::vector<uint32_t>& sortedByHeight = generator.sortedByHeight;
+	
+	printf(" - Rasterizing walkable space...\n");
+	
+	std::vector<RasterLayer> layers;
+	std::vector<RasterBox> boxes;
+	
+	// objects with the same top face height are next to each other in height order, each run of them is a layer
+	for(uint32_t begin = 0; begin < objectCount;){
+		uint32_t end = begin + 1;
+		
+		while(end < objectCount && objects->tops[sortedByHeight[end]] == objects->tops[sortedByHeight[begin]]){
+			end++;
+		}
+		
+		layers.emplace_back();
+		
+		rasterizeLayer(&generator, &layers.back(), begin, end);
+		meshLayer(&layers.back(), layers.size()-1, boxes);
+		
+		begin = end;
+	}
+	
+	if(boxes.size() < 1){
+		printf("No boxes were generated.\n");
+		return;
+	}
+	
+	printf(" - Linking boxes...\n");
+	
+	std::vector<std::pair<uint32_t, uint32_t>> links;
+	linkRasterBoxes(&generator, layers, boxes, links);
+	
+	layers.clear();
+	
+	// write boxes to the walkmap (links are sorted by box, so they can be copied straight into the adjacency)
+	float resolution = settings.rasterResolution;
+	
+	walkmap->boxes.reserve(boxes.size());
+	walkmap->offsets.reserve(boxes.size() + 1);
+	walkmap->edges.reserve(links.size());
+	
+	// amount of boxes each object has been meshed into so far (for ids)
+	std::vector<uint32_t> children(settings.generateIds ? objectCount : 0, 0);
+	
+	uint32_t link = 0;
+	
+	for(const RasterBox& box : boxes){
+		glm::vec2 low = glm::vec2(box.first) * resolution;
+		glm::vec2 high = glm::vec2(box.last + 1) * resolution;
+		
+		uint32_t index = addCompactBox(walkmap, glm::vec3((low.x + high.x) / 2.f, objects->tops[box.owner], (low.y + high.y) / 2.f), high - low);
+		
+		for(; link < links.size() && links[link].first == index; link++){
+			walkmap->edges.push_back(links[link].second);
+		}
+		
+		walkmap->offsets.back() = walkmap->edges.size();
+		
+		// give boxes ids, if desired
+		if(settings.generateIds){
+			for(uint32_t j = 0; j < objects->idCounts[box.owner]; j++){
+				std::string id = std::string(getObjectId(objects, box.owner, j)) + std::to_string(children[box.owner]);
+				
+				walkmap->ids.push_back( std::make_pair(walkmap->idPool.length(), id.length()) );
+				walkmap->idPool += id;
+				
+				children[box.owner]++;
+			}
+			
+			walkmap->boxes[index].idCount = objects->idCounts[box.owner];
+		}
+	}
+	
+	finishWalkmap(settings, walkmap);
+}
@@ -0,0 +1,172 @@
+// vectorized byte scanning
+#include <scan.hpp>
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#define WALKMAP_SCAN_X86
+	
+	#include <immintrin.h>
+#endif
+
+// scalar kernel (also used for partial blocks at the end of a buffer)
+static uint64_t scanScalar(const char* block, size_t length, const ScanSet& set){
+	uint64_t mask = 0;
+	
+	for(size_t i = 0; i < length; i++){
+		mask |= (uint64_t)set.table[(unsigned char)block[i]] << i;
+	}
+	
+	return mask;
+}
+
+static uint64_t scanScalarBlock(const char* block, const ScanSet& set){
+	return scanScalar(block, SCAN_BLOCK_SIZE, set);
+}
+
+#ifdef WALKMAP_SCAN_X86
+// 16 bytes at a time
+__attribute__((target("sse2")))
+static uint64_t scanSSE2Block(const char* block, const ScanSet& set){
+	uint64_t mask = 0;
+	
+	for(uint32_t offset = 0; offset < SCAN_BLOCK_SIZE; offset += 16){
+		__m128i chunk = _mm_loadu_si128((const __m128i*)(block + offset));
+		__m128i matches = _mm_setzero_si128();
+		
+		for(uint32_t i = 0; i < set.count; i++){
+			matches = _mm_or_si128(matches, _mm_cmpeq_epi8(chunk, _mm_load_si128((const __m128i*)set.splats[i])));
+		}
+		
+		mask |= (uint64_t)(uint32_t)_mm_movemask_epi8(matches) << offset;
+	}
+	
+	return mask;
+}
+
+// 32 bytes at a time
+__attribute__((target("avx2")))
+static uint64_t scanAVX2Block(const char* block, const ScanSet& set){
+	__m256i low = _mm256_loadu_si256((const __m256i*)block);
+	__m256i high = _mm256_loadu_si256((const __m256i*)(block + 32));
+	
+	__m256i lowMatches = _mm256_setzero_si256();
+	__m256i highMatches = _mm256_setzero_si256();
+	
+	for(uint32_t i = 0; i < set.count; i++){
+		__m256i needle = _mm256_load_si256((const __m256i*)set.splats[i]);
+		
+		lowMatches = _mm256_or_si256(lowMatches, _mm256_cmpeq_epi8(low, needle));
+		highMatches = _mm256_or_si256(highMatches, _mm256_cmpeq_epi8(high, needle));
+	}
+	
+	return (uint64_t)(uint32_t)_mm256_movemask_epi8(lowMatches) | ((uint64_t)(uint32_t)_mm256_movemask_epi8(highMatches) << 32);
+}
+#endif
+
+// active kernel
+static ScanKernel activeKernel = SCAN_KERNEL_AUTO;
+static uint64_t (*activeBlockScanner)(const char*, const ScanSet&) = NULL;
+
+ScanSet createScanSet(const char* bytes){
+	ScanSet set;
+	
+	set.count = 0;
+	memset(set.table, 0, sizeof(set.table));
+	
+	for(; *bytes != 0 && set.count < SCAN_SET_CAPACITY; bytes++){
+		memset(set.splats[set.count], *bytes, sizeof(set.splats[set.count]));
+		set.table[(unsigned char)*bytes] = true;
+		
+		set.count++;
+	}
+	
+	return set;
+}
+
+ScanCursor createScanCursor(const char* data, size_t size, const ScanSet* set){
+	ScanCursor cursor;
+	
+	cursor.data = data;
+	cursor.size = size;
+	cursor.set = set;
+	
+	scanSeek(cursor, 0);
+	
+	return cursor;
+}
+
+void scanSeek(ScanCursor& cursor, size_t index){
+	// blocks are relative to the start of the buffer, the kernels don't need aligned loads
+	cursor.block = index - index % SCAN_BLOCK_SIZE;
+	
+	if(index >= cursor.size){
+		cursor.block = cursor.size;
+		cursor.mask = 0;
+		return;
+	}
+	
+	// drop everything before index
+	cursor.mask = scanBlock(cursor, cursor.block) & (~0ULL << (index - cursor.block));
+}
+
+uint64_t scanBlock(const ScanCursor& cursor, size_t block){
+	if(activeBlockScanner == NULL) setScanKernel(SCAN_KERNEL_AUTO);
+	
+	// the last block might be cut off, the vector kernels can't read past the end of the buffer (mapped files aren't padded)
+	if(block + SCAN_BLOCK_SIZE > cursor.size) return scanScalar(cursor.data + block, cursor.size - block, *cursor.set);
+	
+	return activeBlockScanner(cursor.data + block, *cursor.set);
+}
+
+ScanKernel setScanKernel(ScanKernel kernel){
+	#ifdef WALKMAP_SCAN_X86
+	__builtin_cpu_init();
+	
+	bool hasSSE2 = __builtin_cpu_supports("sse2");
+	bool hasAVX2 = __builtin_cpu_supports("avx2");
+	
+	// pick the widest kernel available
+	if(kernel == SCAN_KERNEL_AUTO) kernel = hasAVX2 ? SCAN_KERNEL_AVX2 : SCAN_KERNEL_SSE2;
+	
+	// fall back to narrower kernels if the requested one isn't supported
+	if(kernel == SCAN_KERNEL_AVX2 && !hasAVX2) kernel = SCAN_KERNEL_SSE2;
+	if(kernel == SCAN_KERNEL_SSE2 && !hasSSE2) kernel = SCAN_KERNEL_SCALAR;
+	#else
+	kernel = SCAN_KERNEL_SCALAR;
+	#endif
+	
+	switch(kernel){
+		#ifdef WALKMAP_SCAN_X86
+		case SCAN_KERNEL_AVX2:
+			activeBlockScanner = scanAVX2Block;
+			break;
+		case SCAN_KERNEL_SSE2:
+			activeBlockScanner = scanSSE2Block;
+			break;
+		#endif
+		default:
+			kernel = SCAN_KERNEL_SCALAR;
+			activeBlockScanner = scanScalarBlock;
+			break;
+	}
+	
+	activeKernel = kernel;
+	
+	return kernel;
+}
+
+ScanKernel getScanKernel(){
+	if(activeBlockScanner == NULL) setScanKernel(SCAN_KERNEL_AUTO);
+	
+	return activeKernel;
+}
+
+const char* getScanKernelName(ScanKernel kernel){
+	switch(kernel){
+		case SCAN_KERNEL_SCALAR: return "scalar";
+		case SCAN_KERNEL_SSE2: return "sse2";
+		case SCAN_KERNEL_AVX2: return "avx2";
+		default: return "auto";
+	}
+}
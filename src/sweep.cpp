@@ -0,0 +1,434 @@
+// sweep walkmap engine
+#include <sweep.hpp>
+#include <utils.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <ctgmath>
+#include <cstdio>
+#include <string>
+
+bool sweepBoxesTouch(const SweepBox& a, const SweepBox& b){
+	return bboxIntersection((a.low + a.high) / 2.f, a.high - a.low, (b.low + b.high) / 2.f, b.high - b.low);
+}
+
+// update the amount of obstructions covering elementary z ranges [low, high] (node covers [first, last])
+static void updateCover(SweepState* state, uint32_t node, uint32_t first, uint32_t last, uint32_t low, uint32_t high, int32_t delta){
+	if(high < first || low > last) return;
+	
+	bool leaf = first == last;
+	
+	if(low <= first && last <= high){
+		state->cover[node] += delta;
+	} else {
+		uint32_t middle = (first + last) / 2;
+		
+		updateCover(state, node*2, first, middle, low, high, delta);
+		updateCover(state, node*2+1, middle+1, last, low, high, delta);
+	}
+	
+	state->full[node] = state->cover[node] > 0 || (!leaf && state->full[node*2] && state->full[node*2+1]);
+	state->covered[node] = state->cover[node] > 0 || (!leaf && (state->covered[node*2] || state->covered[node*2+1]));
+}
+
+// push every z range under node that isn't covered to free (ranges that touch are joined)
+static void collectFree(SweepState* state, uint32_t node, uint32_t first, uint32_t last){
+	if(state->full[node]) return;
+	
+	if(!state->covered[node]){
+		float low = state->zs[first];
+		float high = state->zs[last+1];
+		
+		if(state->free.size() > 0 && state->free.back().y == low){
+			state->free.back().y = high;
+		} else {
+			state->free.push_back(glm::vec2(low, high));
+		}
+		
+		return;
+	}
+	
+	uint32_t middle = (first + last) / 2;
+	
+	collectFree(state, node*2, first, middle);
+	collectFree(state, node*2+1, middle+1, last);
+}
+
+void subtractObstructions(SweepState* state, const SweepBox& surface, const std::vector<SweepBox>& obstructions, std::vector<SweepBox>& boxes, std::vector<std::pair<uint32_t, uint32_t>>& links){
+	if(surface.low.x >= surface.high.x || surface.low.y >= surface.high.y) return;
+	
+	// nothing is left if a single obstruction covers everything
+	for(const SweepBox& obstruction : obstructions){
+		if(obstruction.low.x <= surface.low.x && obstruction.low.y <= surface.low.y && obstruction.high.x >= surface.high.x && obstruction.high.y >= surface.high.y) return;
+	}
+	
+	// every z an obstruction starts or ends at (obstructions are clipped to the surface, ones that only touch it don't take anything away from it)
+	std::vector<float>& zs = state->zs;
+	zs.clear();
+	
+	zs.push_back(surface.low.y);
+	zs.push_back(surface.high.y);
+	
+	for(const SweepBox& obstruction : obstructions){
+		glm::vec2 low = glm::max(obstruction.low, surface.low);
+		glm::vec2 high = glm::min(obstruction.high, surface.high);
+		
+		if(low.x >= high.x || low.y >= high.y) continue;
+		
+		zs.push_back(low.y);
+		zs.push_back(high.y);
+	}
+	
+	std::sort(zs.begin(), zs.end());
+	zs.erase( std::unique(zs.begin(), zs.end()), zs.end() );
+	
+	// every x the covered z ranges change at, nothing changes in the slabs between them
+	std::vector<SweepEvent>& events = state->events;
+	events.clear();
+	
+	for(const SweepBox& obstruction : obstructions){
+		glm::vec2 low = glm::max(obstruction.low, surface.low);
+		glm::vec2 high = glm::min(obstruction.high, surface.high);
+		
+		if(low.x >= high.x || low.y >= high.y) continue;
+		
+		SweepEvent event;
+		event.low = std::lower_bound(zs.begin(), zs.end(), low.y) - zs.begin();
+		event.high = std::lower_bound(zs.begin(), zs.end(), high.y) - zs.begin() - 1;
+		
+		event.x = low.x;
+		event.delta = 1;
+		events.push_back(event);
+		
+		event.x = high.x;
+		event.delta = -1;
+		events.push_back(event);
+	}
+	
+	std::sort(events.begin(), events.end(), [](const SweepEvent& a, const SweepEvent& b){
+		return a.x < b.x;
+	});
+	
+	uint32_t ranges = zs.size() - 1;
+	
+	state->cover.assign(ranges * 4, 0);
+	state->full.assign(ranges * 4, 0);
+	state->covered.assign(ranges * 4, 0);
+	
+	std::vector<uint32_t>& open = state->open;
+	std::vector<uint32_t>& stillOpen = state->stillOpen;
+	std::vector<uint32_t>& closed = state->closed;
+	std::vector<uint32_t>& opened = state->opened;
+	
+	open.clear();
+	
+	float x = surface.low.x;
+	uint32_t e = 0;
+	
+	while(true){
+		for(; e < events.size() && events[e].x <= x; e++){
+			updateCover(state, 1, 0, ranges-1, events[e].low, events[e].high, events[e].delta);
+		}
+		
+		state->free.clear();
+		collectFree(state, 1, 0, ranges-1);
+		
+		// boxes with the exact same z range keep growing, the rest are closed here and new boxes are opened for the ranges that are left
+		stillOpen.clear();
+		closed.clear();
+		opened.clear();
+		
+		uint32_t o = 0;
+		
+		for(glm::vec2 range : state->free){
+			while(o < open.size() && boxes[open[o]].low.y < range.x){
+				closed.push_back(open[o++]);
+			}
+			
+			if(o < open.size() && boxes[open[o]].low.y == range.x && boxes[open[o]].high.y == range.y){
+				stillOpen.push_back(open[o++]);
+				continue;
+			}
+			
+			SweepBox box;
+			box.owner = surface.owner;
+			box.low = glm::vec2(x, range.x);
+			box.high = glm::vec2(x, range.y);
+			
+			opened.push_back(boxes.size());
+			stillOpen.push_back(boxes.size());
+			
+			boxes.push_back(box);
+		}
+		
+		while(o < open.size()){
+			closed.push_back(open[o++]);
+		}
+		
+		for(uint32_t c : closed){
+			boxes[c].high.x = x;
+		}
+		
+		// boxes closed and opened here are next to each other if their z ranges overlap (both are sorted by z and don't overlap themselves)
+		for(uint32_t c = 0, n = 0; c < closed.size() && n < opened.size();){
+			const SweepBox& closedBox = boxes[closed[c]];
+			const SweepBox& openedBox = boxes[opened[n]];
+			
+			if(std::min(closedBox.high.y, openedBox.high.y) > std::max(closedBox.low.y, openedBox.low.y)){
+				links.push_back(std::make_pair(closed[c], opened[n]));
+				links.push_back(std::make_pair(opened[n], closed[c]));
+			}
+			
+			if(closedBox.high.y < openedBox.high.y){
+				c++;
+			} else {
+				n++;
+			}
+		}
+		
+		open.swap(stillOpen);
+		
+		// next slab
+		if(e >= events.size() || events[e].x >= surface.high.x) break;
+		
+		x = events[e].x;
+	}
+	
+	for(uint32_t b : open){
+		boxes[b].high.x = surface.high.x;
+	}
+}
+
+// cells of the sweep grid an area overlaps, clamped to the grid
+static inline void getSweepCells(const SweepState* state, glm::vec2 low, glm::vec2 high, glm::uvec2& first, glm::uvec2& last){
+	glm::vec2 cells = glm::vec2(state->gridWidth, state->gridDepth);
+	
+	first = glm::uvec2( glm::clamp(glm::floor((low - state->gridOrigin) / state->gridCellSize), glm::vec2(0), cells - 1.f) );
+	last = glm::uvec2( glm::clamp(glm::floor((high - state->gridOrigin) / state->gridCellSize), glm::vec2(0), cells - 1.f) );
+}
+
+void buildSweepGrid(SweepState* state, const std::vector<SweepBox>& boxes, uint32_t begin, uint32_t end){
+	uint32_t count = end - begin;
+	
+	glm::vec2 low = glm::vec2(FLT_MAX);
+	glm::vec2 high = glm::vec2(-FLT_MAX);
+	
+	for(uint32_t b = begin; b < end; b++){
+		low = glm::min(low, boxes[b].low);
+		high = glm::max(high, boxes[b].high);
+	}
+	
+	// about one box per cell
+	uint32_t cellsPerAxis = std::min(1024u, std::max(1u, (uint32_t)std::ceil(std::sqrt((float)count))));
+	
+	state->gridOrigin = low;
+	state->gridCellSize = glm::max((high - low) / (float)cellsPerAxis, glm::vec2(FLT_MIN));
+	state->gridWidth = cellsPerAxis;
+	state->gridDepth = cellsPerAxis;
+	
+	uint32_t cellCount = cellsPerAxis * cellsPerAxis;
+	
+	// count boxes in each cell, then fill them in
+	state->cellOffsets.assign(cellCount + 1, 0);
+	
+	for(uint32_t b = begin; b < end; b++){
+		glm::uvec2 first, last;
+		getSweepCells(state, boxes[b].low, boxes[b].high, first, last);
+		
+		for(uint32_t z = first.y; z <= last.y; z++){
+			for(uint32_t x = first.x; x <= last.x; x++){
+				state->cellOffsets[z * cellsPerAxis + x + 1]++;
+			}
+		}
+	}
+	
+	for(uint32_t i = 0; i < cellCount; i++){
+		state->cellOffsets[i+1] += state->cellOffsets[i];
+	}
+	
+	state->cellBoxes.resize(state->cellOffsets.back());
+	
+	std::vector<uint32_t> nextBox(state->cellOffsets.begin(), state->cellOffsets.end()-1);
+	
+	for(uint32_t b = begin; b < end; b++){
+		glm::uvec2 first, last;
+		getSweepCells(state, boxes[b].low, boxes[b].high, first, last);
+		
+		for(uint32_t z = first.y; z <= last.y; z++){
+			for(uint32_t x = first.x; x <= last.x; x++){
+				state->cellBoxes[nextBox[z * cellsPerAxis + x]++] = b - begin;
+			}
+		}
+	}
+	
+	state->boxStamps.assign(count, 0);
+	state->query = 0;
+}
+
+void querySweepGrid(SweepState* state, const std::vector<SweepBox>& boxes, uint32_t begin, const SweepBox& area, std::vector<uint32_t>& found){
+	// grow the area so that boxes sweepBoxesTouch counts as touching are always found (nearly_equal is relative, so the padding grows with the coordinates)
+	float largest = std::max( std::max(std::abs(area.low.x), std::abs(area.low.y)), std::max(std::abs(area.high.x), std::abs(area.high.y)) );
+	float padding = largest * 1e-4f + 1e-6f;
+	
+	glm::uvec2 first, last;
+	getSweepCells(state, area.low - padding, area.high + padding, first, last);
+	
+	uint32_t query = ++state->query;
+	
+	for(uint32_t z = first.y; z <= last.y; z++){
+		for(uint32_t x = first.x; x <= last.x; x++){
+			uint32_t cell = z * state->gridWidth + x;
+			
+			for(uint32_t i = state->cellOffsets[cell]; i < state->cellOffsets[cell+1]; i++){
+				uint32_t b = state->cellBoxes[i];
+				
+				if(state->boxStamps[b] == query) continue;
+				
+				state->boxStamps[b] = query;
+				
+				if(sweepBoxesTouch(boxes[begin + b], area)) found.push_back(begin + b);
+			}
+		}
+	}
+}
+
+// generate walkmap by subtracting every obstruction from each object at once
+void generateSweepWalkmap(WalkmapSettings& settings, const ObjectArrays* objects, CompactWalkmap* walkmap){
+	uint32_t objectCount = objects->positions.size();
+	
+	WalkmapGenerator generator;
+	initializeGenerator(&generator, settings, objects);
+	
+	const std::vector<uint32_t>& sortedByHeight = generator.sortedByHeight;
+	
+	printf(" - Calculating walkable space...\n");
+	
+	std::vector<SweepBox> boxes;
+	std::vector<std::pair<uint32_t, uint32_t>> links;
+	
+	// range of boxes each object ended up as
+	std::vector<std::pair<uint32_t, uint32_t>> objectBoxes(objectCount);
+	
+	// boxes and the objects they can step onto, linked to the object's boxes once every object is done
+	std::vector<std::pair<uint32_t, uint32_t>> steps;
+	
+	std::vector<uint32_t> candidates;
+	std::vector<SweepBox> obstructions;
+	std::vector<uint32_t> touching;
+	
+	SweepState state;
+	
+	for(uint32_t i = 0; i < objectCount; i++){
+		uint32_t object = sortedByHeight[i];
+		
+		SweepBox surface;
+		surface.owner = object;
+		getObjectFootprint(objects, object, surface.low, surface.high);
+		
+		// every object ahead of this one (in height order) that's close enough to get in the way
+		generator.processing = i;
+		activateObjects(&generator, objects->tops[object]);
+		
+		obstructions.clear();
+		
+		if(i+1 < objectCount){
+			BoundingBox bounds;
+			bounds.position = glm::vec3((surface.low.x + surface.high.x) / 2.f, objects->tops[object], (surface.low.y + surface.high.y) / 2.f);
+			bounds.size = surface.high - surface.low;
+			
+			queryObjectGrid(&generator, &bounds, i+1, candidates);
+			
+			for(uint32_t j : candidates){
+				SweepBox obstruction;
+				obstruction.owner = sortedByHeight[j];
+				getObjectFootprint(objects, obstruction.owner, obstruction.low, obstruction.high);
+				
+				if(sweepBoxesTouch(surface, obstruction)) obstructions.push_back(obstruction);
+			}
+		}
+		
+		uint32_t firstBox = boxes.size();
+		
+		subtractObstructions(&state, surface, obstructions, boxes, links);
+		
+		objectBoxes[object] = std::make_pair(firstBox, (uint32_t)boxes.size());
+		
+		// objects that can be stepped onto are linked to every box that touches them
+		bool gridBuilt = false;
+		
+		for(const SweepBox& obstruction : obstructions){
+			// nothing left to step from
+			if(firstBox == boxes.size()) break;
+			
+			if(!nearly_less_or_eq(objects->tops[obstruction.owner] - objects->tops[object], settings.stepHeight)) continue;
+			
+			if(!gridBuilt){
+				buildSweepGrid(&state, boxes, firstBox, boxes.size());
+				gridBuilt = true;
+			}
+			
+			touching.clear();
+			querySweepGrid(&state, boxes, firstBox, obstruction, touching);
+			
+			for(uint32_t b : touching){
+				steps.push_back(std::make_pair(b, obstruction.owner));
+			}
+		}
+	}
+	
+	if(boxes.size() < 1){
+		printf("No boxes were generated.\n");
+		return;
+	}
+	
+	// link step boxes to the boxes of the objects they step onto that they touch
+	for(std::pair<uint32_t, uint32_t> step : steps){
+		std::pair<uint32_t, uint32_t> range = objectBoxes[step.second];
+		
+		for(uint32_t b = range.first; b < range.second; b++){
+			if(!sweepBoxesTouch(boxes[step.first], boxes[b])) continue;
+			
+			links.push_back(std::make_pair(step.first, b));
+			links.push_back(std::make_pair(b, step.first));
+		}
+	}
+	
+	std::sort(links.begin(), links.end());
+	links.erase( std::unique(links.begin(), links.end()), links.end() );
+	
+	// write boxes to the walkmap (links are sorted by box, so they can be copied straight into the adjacency)
+	walkmap->boxes.reserve(boxes.size());
+	walkmap->offsets.reserve(boxes.size() + 1);
+	walkmap->edges.reserve(links.size());
+	
+	// amount of boxes each object has been split into so far (for ids)
+	std::vector<uint32_t> children(settings.generateIds ? objectCount : 0, 0);
+	
+	uint32_t link = 0;
+	
+	for(const SweepBox& box : boxes){
+		uint32_t index = addCompactBox(walkmap, glm::vec3((box.low.x + box.high.x) / 2.f, objects->tops[box.owner], (box.low.y + box.high.y) / 2.f), box.high - box.low);
+		
+		for(; link < links.size() && links[link].first == index; link++){
+			walkmap->edges.push_back(links[link].second);
+		}
+		
+		walkmap->offsets.back() = walkmap->edges.size();
+		
+		// give boxes ids, if desired
+		if(settings.generateIds){
+			for(uint32_t j = 0; j < objects->idCounts[box.owner]; j++){
+				std::string id = std::string(getObjectId(objects, box.owner, j)) + std::to_string(children[box.owner]);
+				
+				walkmap->ids.push_back( std::make_pair(walkmap->idPool.length(), id.length()) );
+				walkmap->idPool += id;
+				
+				children[box.owner]++;
+			}
+			
+			walkmap->boxes[index].idCount = objects->idCounts[box.owner];
+		}
+	}
+	
+	finishWalkmap(settings, walkmap);
+}
@@ -9,6 +9,18 @@
 #include <cassert>
 #include <cfloat>
 #include <algorithm>
+#include <cstring>
+#include <charconv>
+
+// memory mapping is only available on posix systems, everything else uses the buffered path
+#if defined(__unix__) || defined(__APPLE__)
+	#define WALKMAP_HAS_MMAP
+	
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
 
 // NOTE: Free buffer when done with it.
 char* read_entire_file(const char* file)
@@ -19,16 +31,153 @@ char* read_entire_file(const char* file)
 		perror("poor");
 		return NULL;
 	}
-	fseek(source_file, 0, SEEK_END);
-	long src_size = ftell(source_file);
-	fseek(source_file, 0, SEEK_SET);
-	char* buffer = (char*) malloc(src_size + 1);
-	fread(buffer, 1, src_size, source_file);
+	size_t src_size;
+	char* buffer = read_entire_file(source_file, &src_size);
 	fclose(source_file);
+	return buffer;
+}
+
+// reads until EOF instead of seeking to the end, so this works on pipes as well
+// NOTE: Free buffer when done with it.
+char* read_entire_file(FILE* source_file, size_t* size)
+{
+	size_t capacity = 1 << 16;
+	size_t src_size = 0;
+	char* buffer = (char*) malloc(capacity + 1);
+	
+	while (buffer)
+	{
+		// buffer full, grow it
+		if (src_size == capacity)
+		{
+			capacity *= 2;
+			char* grown = (char*) realloc(buffer, capacity + 1);
+			if (!grown) free(buffer);
+			buffer = grown;
+			continue;
+		}
+		
+		// fread only comes up empty at EOF (or on an error)
+		size_t read = fread(buffer + src_size, 1, capacity - src_size, source_file);
+		if (read == 0) break;
+		src_size += read;
+	}
+	
+	if (!buffer) return NULL;
+	
 	buffer[src_size] = 0;
+	*size = src_size;
 	return buffer;
 }
 
+// map a file into memory
+FileBuffer* mapEntireFile(const char* file){
+	FileBuffer* buffer = allocateMemoryForType<FileBuffer>();
+	
+	buffer->data = NULL;
+	buffer->size = 0;
+	buffer->mapped = false;
+	
+	#ifdef WALKMAP_HAS_MMAP
+	int fd = open(file, O_RDONLY);
+	
+	if(fd < 0){
+		perror("poor");
+		free(buffer);
+		return NULL;
+	}
+	
+	struct stat info;
+	
+	// only regular files can be mapped, anything else (pipes, character devices, etc.) goes through the buffered path
+	if(fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0){
+		void* view = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		
+		if(view != MAP_FAILED){
+			// the parser only ever walks forward through the file, so tell the kernel to read ahead aggressively and drop pages behind us
+			madvise(view, info.st_size, MADV_SEQUENTIAL);
+			madvise(view, info.st_size, MADV_WILLNEED);
+			
+			buffer->data = (const char*)view;
+			buffer->size = info.st_size;
+			buffer->mapped = true;
+		}
+	}
+	
+	if(!buffer->mapped){
+		FILE* source_file = fdopen(fd, "rb");
+		
+		if(source_file){
+			buffer->data = read_entire_file(source_file, &buffer->size);
+			fclose(source_file);
+		} else {
+			close(fd);
+		}
+	} else {
+		// the mapping stays valid after the descriptor is closed
+		close(fd);
+	}
+	#else
+	buffer->data = read_entire_file(file);
+	if(buffer->data) buffer->size = strlen(buffer->data);
+	#endif
+	
+	if(buffer->data == NULL){
+		free(buffer);
+		return NULL;
+	}
+	
+	return buffer;
+}
+
+void unmapEntireFile(FileBuffer* buffer){
+	if(buffer == NULL) return;
+	
+	#ifdef WALKMAP_HAS_MMAP
+	if(buffer->mapped){
+		munmap((void*)buffer->data, buffer->size);
+	} else {
+		free((void*)buffer->data);
+	}
+	#else
+	free((void*)buffer->data);
+	#endif
+	
+	free(buffer);
+}
+
+// multiply + rotate over 8 bytes at a time, finished off with murmur3's fmix64
+uint64_t hashBuffer(const char* data, size_t size){
+	const uint64_t k1 = 0x87c37b91114253d5ULL;
+	const uint64_t k2 = 0x4cf5ad432745937fULL;
+	
+	uint64_t hash = 0x9e3779b97f4a7c15ULL ^ (size * k1);
+	size_t i = 0;
+	
+	for(; i + 8 <= size; i += 8){
+		uint64_t word;
+		memcpy(&word, data + i, sizeof(word));
+		
+		hash ^= word * k1;
+		hash = ((hash << 31) | (hash >> 33)) * k2;
+	}
+	
+	// leftover bytes
+	uint64_t tail = 0;
+	memcpy(&tail, data + i, size - i);
+	
+	hash ^= tail * k2;
+	
+	// fmix64
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+	
+	return hash;
+}
+
 // https://stackoverflow.com/a/32334103
 bool nearly_equal(float a, float b){
 	float epsilon = 256 * FLT_EPSILON;
@@ -55,9 +204,90 @@ bool nearly_greater_or_eq(float a, float b){
 	return (a > b) || nearly_equal(a, b);
 }
 
-// https://stackoverflow.com/a/16575025
-bool isStringNumber(std::string& str){
-	char* p;
-	strtod(str.c_str(), &p);
-	return *p == 0;
+// maps a float to an unsigned int with the same order (negative floats have every bit flipped, positive ones only the sign)
+static inline uint32_t sortableFloatBits(float f){
+	// -0 and 0 compare equal, so they get the same key
+	f += 0.f;
+	
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	
+	return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+void sortIndicesByKey(const float* keys, uint32_t count, std::vector<uint32_t>& sorted){
+	// 3 passes of 11 bits
+	const uint32_t radixBits = 11;
+	const uint32_t radixSize = 1 << radixBits;
+	const uint32_t passes = 3;
+	
+	std::vector<uint32_t> bits(count);
+	std::vector<uint32_t> counts(radixSize * passes, 0);
+	
+	// count every digit of every pass up front
+	for(uint32_t i = 0; i < count; i++){
+		bits[i] = sortableFloatBits(keys[i]);
+		
+		for(uint32_t pass = 0; pass < passes; pass++){
+			counts[pass * radixSize + ((bits[i] >> (pass * radixBits)) & (radixSize-1))]++;
+		}
+	}
+	
+	sorted.resize(count);
+	
+	if(count == 0) return;
+	
+	for(uint32_t i = 0; i < count; i++){
+		sorted[i] = i;
+	}
+	
+	std::vector<uint32_t> scratch(count);
+	
+	for(uint32_t pass = 0; pass < passes; pass++){
+		uint32_t* passCounts = counts.data() + pass * radixSize;
+		uint32_t shift = pass * radixBits;
+		
+		// every key has the same digit, this pass wouldn't move anything
+		if(passCounts[(bits[sorted[0]] >> shift) & (radixSize-1)] == count) continue;
+		
+		// counts to starting offsets
+		uint32_t offset = 0;
+		
+		for(uint32_t digit = 0; digit < radixSize; digit++){
+			uint32_t digitCount = passCounts[digit];
+			
+			passCounts[digit] = offset;
+			offset += digitCount;
+		}
+		
+		// scatter in order, which keeps the sort stable
+		for(uint32_t i = 0; i < count; i++){
+			uint32_t index = sorted[i];
+			
+			scratch[ passCounts[(bits[index] >> shift) & (radixSize-1)]++ ] = index;
+		}
+		
+		sorted.swap(scratch);
+	}
+}
+
+// classify a token as a number and convert it in one pass (str doesn't need to be null terminated)
+// from_chars is locale independent and never allocates or throws, unlike strtod + stof
+bool parseNumber(std::string_view str, float& out){
+	const char* begin = str.data();
+	const char* end = str.data() + str.length();
+	
+	// from_chars doesn't accept a leading plus sign, strtod did
+	if(begin != end && *begin == '+'){
+		begin++;
+		
+		if(begin != end && *begin == '-') return false;
+	}
+	
+	if(begin == end) return false;
+	
+	std::from_chars_result result = std::from_chars(begin, end, out);
+	
+	// only a number if the entire token was consumed (out of range values are treated as strings)
+	return result.ec == std::errc() && result.ptr == end;
 }
\ No newline at end of file
@@ -1,20 +1,46 @@
 // walkmap creation file
 #include <walkmap.hpp>
+#include <raster.hpp>
+#include <sweep.hpp>
 #include <utils.hpp>
 
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 
 #include <algorithm>
+#include <cstring>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <deque>
 #include <ctgmath>
 
-// process an object into bboxes recursively
-void processObject(Object* owner, std::vector<BoundingBox*>* bboxes, std::vector<Object*>* scene, std::vector<uint32_t>* sortedByHeight, uint32_t heightIndex, WalkmapSettings& settings){
-	// any new boxes created below get pushed to here and then pushed to bboxes at the end (to avoid screwing with the loop)
-	std::vector<BoundingBox*> newBboxes;
-	
-	// loop through each bbox
-	for(uint32_t i = 0; i < bboxes->size(); i++){
+// process an object into bboxes
+void processObject(WalkmapGenerator* generator, WalkmapWorker* worker, uint32_t owner, std::vector<BoundingBox*>* bboxes, uint32_t begin, uint32_t end, uint32_t groupBegin, uint32_t groupEnd){
+	const WalkmapSettings& settings = generator->settings;
+	const std::vector<uint32_t>& sortedByHeight = generator->sortedByHeight;
+	
+	// loop through each bbox in [begin, end)
+	// a box that gets split is replaced by NULL, and the boxes it was split into are appended to bboxes (and processed before moving on to the next box)
+	// the boxes still left to process are kept in frames instead of recursing, so boxes can be split as many times as there's memory for
+	std::vector<ProcessFrame>& frames = worker->frames;
+	
+	frames.clear();
+	frames.push_back({begin, end, groupBegin, groupEnd});
+	
+	while(frames.size() > 0){
+		// done with the frame's boxes, pop the group that was pushed for them (the first frame's group isn't ours to pop)
+		if(frames.back().next >= frames.back().end){
+			if(frames.size() > 1) worker->groupStack.resize(frames.back().groupBegin);
+			
+			frames.pop_back();
+			continue;
+		}
+		
+		ProcessFrame frame = frames.back();
+		uint32_t i = frames.back().next++;
+		
 		// get bbox
 		BoundingBox* bbox1 = bboxes->at(i);
 		
@@ -23,28 +49,21 @@ void processObject(Object* owner, std::vector<BoundingBox*>* bboxes, std::vector
 		
 		//printf("sdp: (p: %f, %f, %f, s: %f, %f)\n", bbox1->position.x, bbox1->position.y, bbox1->position.z, bbox1->size.x, bbox1->size.y);
 		
-		// loop through every object ahead of owner
-		for(uint32_t j = heightIndex; j < sortedByHeight->size(); j++){
-			// get object
-			Object* obj2 = scene->at( sortedByHeight->at(j) );
+		// loop through the rest of the owner's collision group (every object ahead of owner that's close enough to intersect, in height order)
+		for(uint32_t c = frame.groupBegin; c < frame.groupEnd; c++){
+			uint32_t j = worker->groupStack[c];
 			
-			// ignore potential intersection if the distance from the bottom face of obj2 and the top face of obj1 exceeds the player height (then obj2 has no effect on obj1's walkable space)
-			if( (obj2->position.y-obj2->scale.y/2.f) - (owner->position.y+owner->scale.y/2.f) >= settings.playerHeight ) continue;
+			// get object
+			uint32_t obj2 = sortedByHeight[j];
+			std::vector<BoundingBox*>& obj2Bboxes = generator->bboxes[obj2];
 			
 			// create bounding box if necessary
-			if(obj2->bboxes->size() <= 0){
-				*obj2->bboxes = {objToBbox(obj2)};
-				
-				//printf("created bbox obj->y: %f bbox->y %f\n", obj2->position.y, obj2->bboxes->at(0)->position.y);
+			if(obj2Bboxes.size() <= 0){
+				obj2Bboxes = {objToBbox(generator->objects, obj2)};
 			}
 			
 			// objects shouldn't have more than one bbox until they're processed, so we can just assume that the first bbox in the vector is the only one for now
-			BoundingBox* bbox2 = obj2->bboxes->at(0);
-			
-			// can these bboxes be stepped between?
-			bool steppable = nearly_less_or_eq(bbox2->position.y - bbox1->position.y, settings.stepHeight);
-			
-			//if(!steppable) printf("not steppable: %f, %f, %f\n", bbox2->position.y, bbox1->position.y, bbox2->position.y - bbox1->position.y);
+			BoundingBox* bbox2 = obj2Bboxes[0];
 			
 			// check for intersection
 			// when checking for intersection we add the player's radius to size in order to account for objects which may not technically be intersecting but would interfere with walkable space.  then, if there is an intersection, bbox1 scale is returned to normal but bbox2 scale is temporarily kept the same to account for its effect on the walkable space.
@@ -60,297 +79,1162 @@ void processObject(Object* owner, std::vector<BoundingBox*>* bboxes, std::vector
 			//printf("got intersect\n");
 			
 			// remove bbox1 from boxes (replaced by splitBoxes)
-			bboxes->erase(bboxes->begin() + i);
-			i--;
+			bboxes->at(i) = NULL;
 			
 			// split bbox
-			std::vector<BoundingBox*> splitBoxes;
-			splitBbox(&splitBoxes, bbox1, bbox2);
-			
-			//printf("checking adjacency\n");
-			
-			// if the distance from each obj's top faces is <= the step height, mark all split bboxes as adjacent to bbox2 (to allow the player to step up to it)
-			//printf("%d: %f, %f, %d\n", sortedByHeight->at(j), bbox2->position.y - bbox1->position.y, settings.stepHeight, steppable);
-			if(steppable){
-				for(uint32_t k = 0; k < splitBoxes.size(); k++){
-					if(splitBoxes.at(k) != NULL) markAdjacent(splitBoxes.at(k), bbox2);
-				}
-				
-				// mark object as reachable (can be reached from this object)
-				obj2->reachable = true;
-			}
+			SplitResult splitBoxes;
+			splitBbox(&splitBoxes, bbox1, bbox2, settings.splitStrategy);
 			
-			//printf("updating adjacency\n");
-			
-			// if bbox1 had any adjacent boxes, update those boxes' adjacency
-			for(uint32_t k = 0; k < bbox1->adjacent->size(); k++){
-				// get adjacent bbox
-				BoundingBox* adjacentBbox = bbox1->adjacent->at(k);
-				
-				// remove bbox1 from adjacentBbox's adjacent vector
-				// FIXME: if std::find fails, this will probably seg fault (but std::find shouldn't fail here)
-				adjacentBbox->adjacent->erase( std::find(adjacentBbox->adjacent->begin(), adjacentBbox->adjacent->end(), bbox1) );
-				
-				// add adjacent boxes
-				// FIXME: might be able to be made more efficient via splitIndex
-				
-				for(uint32_t m = 0; m < splitBoxes.size(); m++){
-					if(splitBoxes.at(m) == NULL) continue;
-					
-					if(bboxIntersection(splitBoxes.at(m), adjacentBbox)) markAdjacent(adjacentBbox, splitBoxes.at(m));
-				}
-				
-				/*if(adjacentBbox->splitIndex != -1){
-					for(int32_t m = 0; m < 1; m++){
-						BoundingBox* other = splitBoxes.at( adjacentBbox->splitIndex+m );
-						
-						if(other != NULL){ markAdjacent(adjacentBbox, other); }
-					}
-				}*/
+			// links to other objects' boxes are made later if there's more than one thread (whatever they link to might not be done yet)
+			if(worker->splits != NULL){
+				worker->splits->push_back({bbox1, obj2, splitBoxes});
+			} else {
+				linkSplit(generator, bbox1, obj2, &splitBoxes);
 			}
 			
 			//if(!steppable) resizeBbox(bbox2, bbox2->size - settings.playerRadius);
 			
 			//printf("processing new bboxes\n");
 			
-			// destroy bbox1
-			destroyBbox(bbox1);
+			// push new boxes to bboxes
+			uint32_t splitBegin = bboxes->size();
 			
-			// process new bboxes
-			j++; // increment j to ignore the object we just went over
-			processObject(owner, &splitBoxes, scene, sortedByHeight, j, settings);
+			for(uint32_t k = 0; k < splitBoxes.count; k++){
+				if(isSplitBoxLive(splitBoxes, k)) bboxes->push_back(splitBoxes.boxes[k]);
+			}
+			
+			uint32_t splitEnd = bboxes->size();
 			
-			// push new boxes to newBboxes
-			newBboxes.insert(newBboxes.end(), splitBoxes.begin(), splitBoxes.end());
+			// process new bboxes next
+			// the split boxes are inside of bbox1, so they only need to be checked against the rest of the group that overlaps bbox1 (pushed on top of the group stack, and popped once their frame is done)
+			uint32_t splitGroupBegin = worker->groupStack.size();
+			narrowCollisionGroup(generator, worker, bbox1, c+1, frame.groupEnd); // c+1 to ignore the object we just went over
+			
+			frames.push_back({splitBegin, splitEnd, splitGroupBegin, (uint32_t)worker->groupStack.size()});
 			
 			// we break here because we don't need to check any more objects with bbox1; the bboxes from the split check the rest
 			break;
 		}
 	}
+
+}
+
+// link the boxes a split produced to each other, to the box they were split by (if it can be stepped onto) and to everything the original box was adjacent to
+void linkSplit(WalkmapGenerator* generator, BoundingBox* original, uint32_t object, const SplitResult* split){
+	const WalkmapSettings& settings = generator->settings;
+	
+	// everything is linked once the walkmap is done instead (see linkCompactBoxes)
+	if(settings.adjacency == WALKMAP_ADJACENCY_POST) return;
+	
+	// the splitter's object hasn't been processed yet, so it only has one box
+	BoundingBox* splitter = generator->bboxes[object][0];
+	
+	// the split boxes go around the splitter, each one touches the next
+	linkSplitBoxes(split);
+	
+	// can these bboxes be stepped between?
+	bool steppable = nearly_less_or_eq(splitter->position.y - original->position.y, settings.stepHeight);
+	
+	// if the distance from each obj's top faces is <= the step height, mark all split bboxes as adjacent to splitter (to allow the player to step up to it)
+	if(steppable){
+		for(uint32_t k = 0; k < split->count; k++){
+			if(isSplitBoxLive(*split, k)) markAdjacent(split->boxes[k], splitter);
+		}
+		
+		// mark object as reachable (can be reached from this object)
+		generator->reachable[object] = true;
+	}
+	
+	//printf("updating adjacency\n");
 	
-	// copy new boxes to bboxes
-	bboxes->insert(bboxes->end(), newBboxes.begin(), newBboxes.end());
+	// if original had any adjacent boxes, update those boxes' adjacency
+	for(uint32_t k = 0; k < original->adjacent->size(); k++){
+		// get adjacent bbox
+		BoundingBox* adjacentBbox = original->adjacent->at(k);
+		
+		// remove original from adjacentBbox's adjacent vector
+		// FIXME: if std::find fails, this will probably seg fault (but std::find shouldn't fail here)
+		adjacentBbox->adjacent->erase( std::find(adjacentBbox->adjacent->begin(), adjacentBbox->adjacent->end(), original) );
+		
+		// add adjacent boxes
+		// FIXME: might be able to be made more efficient via splitIndex
+		
+		for(uint32_t m = 0; m < split->count; m++){
+			if(!isSplitBoxLive(*split, m)) continue;
+			
+			if(bboxIntersection(split->boxes[m], adjacentBbox)) markAdjacent(adjacentBbox, split->boxes[m]);
+		}
+		
+		/*if(adjacentBbox->splitIndex != -1){
+			for(int32_t m = 0; m < 1; m++){
+				BoundingBox* other = splitBoxes.at( adjacentBbox->splitIndex+m );
+				
+				if(other != NULL){ markAdjacent(adjacentBbox, other); }
+			}
+		}*/
+	}
+}
+
+// first and last cell (inclusive) covering an area, areas outside of the grid are clamped to it
+static inline void getGridCells(const ObjectGrid& grid, glm::vec2 low, glm::vec2 high, glm::uvec2& first, glm::uvec2& last){
+	glm::vec2 cells = glm::vec2(grid.width, grid.depth);
+	
+	first = glm::uvec2( glm::clamp(glm::floor((low - grid.origin) / grid.cellSize), glm::vec2(0), cells - 1.f) );
+	last = glm::uvec2( glm::clamp(glm::floor((high - grid.origin) / grid.cellSize), glm::vec2(0), cells - 1.f) );
 }
 
-// push bboxes to a walkmap
-void pushBboxes(BoundingBox* bbox){
-	// ignore null
-	if(bbox == NULL) return;
+// bucket every object's footprint into a uniform grid
+void buildObjectGrid(WalkmapGenerator* generator){
+	const ObjectArrays* objects = generator->objects;
+	ObjectGrid& grid = generator->grid;
 	
-	// if this bbox has already been reached, ignore
-	if( bbox->reachable ) return;
+	uint32_t objectCount = generator->sortedByHeight.size();
 	
-	// mark for non-deletion
-	bbox->reachable = 1;
+	// bounds of every footprint
+	glm::vec2 low = glm::vec2(FLT_MAX);
+	glm::vec2 high = glm::vec2(-FLT_MAX);
 	
-	// check for null adjacent
-	if(bbox->adjacent == NULL) return;
+	std::vector<float> extents(objectCount);
 	
-	// iterate through adjacent boxes and push them to walkmap
-	for(uint32_t i = 0; i < bbox->adjacent->size(); i++){
-		pushBboxes(bbox->adjacent->at(i));
+	for(uint32_t i = 0; i < objectCount; i++){
+		glm::vec2 position = glm::vec2(objects->positions[i].x, objects->positions[i].z);
+		glm::vec2 halfSize = glm::vec2(objects->scales[i].x, objects->scales[i].z) / 2.f;
+		
+		low = glm::min(low, position - halfSize);
+		high = glm::max(high, position + halfSize);
+		
+		extents[i] = std::max(halfSize.x, halfSize.y) * 2.f;
 	}
 	
-	// done
+	glm::vec2 size = glm::max(high - low, glm::vec2(FLT_MIN));
+	
+	// nearly_equal is relative, so the padding has to grow with the coordinates
+	float largest = std::max( std::max(std::abs(low.x), std::abs(low.y)), std::max(std::abs(high.x), std::abs(high.y)) );
+	grid.padding = largest * 1e-4f + 1e-6f;
+	
+	grid.cellSize = generator->settings.cellSize;
+	
+	if(grid.cellSize <= 0){
+		// about the size of a typical object, but never so small that there are more cells than objects (a floor would cover all of them)
+		std::nth_element(extents.begin(), extents.begin() + objectCount/2, extents.end());
+		
+		grid.cellSize = std::max( extents[objectCount/2], std::sqrt(size.x * size.y / objectCount) );
+	}
+	
+	// keep the grid to a sane amount of cells no matter what the cell size is
+	const float maxCellsPerAxis = 1024;
+	
+	grid.cellSize = std::max(grid.cellSize, std::max(size.x, size.y) / maxCellsPerAxis);
+	
+	grid.origin = low;
+	grid.width = std::max(1u, (uint32_t)std::ceil(size.x / grid.cellSize));
+	grid.depth = std::max(1u, (uint32_t)std::ceil(size.y / grid.cellSize));
+	
+	uint32_t cellCount = grid.width * grid.depth;
+	
+	// cell range of each object
+	grid.firstCells.resize(objectCount);
+	grid.lastCells.resize(objectCount);
+	
+	for(uint32_t j = 0; j < objectCount; j++){
+		uint32_t object = generator->sortedByHeight[j];
+		
+		glm::vec2 position = glm::vec2(objects->positions[object].x, objects->positions[object].z);
+		glm::vec2 halfSize = glm::vec2(objects->scales[object].x, objects->scales[object].z) / 2.f;
+		
+		getGridCells(grid, position - halfSize, position + halfSize, grid.firstCells[j], grid.lastCells[j]);
+	}
+	
+	grid.cells.assign(cellCount, std::vector<uint32_t>());
+	
+	// nothing is active until the first object is processed
+	sortIndicesByKey(generator->bottomsByHeight.data(), objectCount, generator->sortedByBottom);
+	generator->activated = 0;
+	generator->processing = 0;
+	
+	generator->queryStamps.assign(objectCount, 0);
+	generator->query = 0;
 }
 
-// non-recursive version of pushBboxes (this avoids stack overflow with too many bboxes)
-// this isn't all that bad efficiency wise compared to pushBboxes, so I'll probably stick to this.  the worst part is just the vector reallocation, but the lack of stack overflow makes up for it
-void pushBboxesNoRecurse(BoundingBox* bbox){
-	std::vector<BoundingBox*> parents = {bbox};
+// add every object whose bottom face is less than the player height above top to the grid
+// tops only increase as objects are processed, so objects are never deactivated this way (they're removed from the grid once processed instead)
+void activateObjects(WalkmapGenerator* generator, float top){
+	ObjectGrid& grid = generator->grid;
 	
-	while(parents.size() > 0){
-		BoundingBox* active = parents.back();
-		uint32_t index = parents.size()-1;
+	while(generator->activated < generator->sortedByBottom.size()){
+		uint32_t j = generator->sortedByBottom[generator->activated];
+		
+		if(generator->bottomsByHeight[j] - top >= generator->settings.playerHeight) break;
+		
+		generator->activated++;
 		
-		active->reachable = 1;
+		// already processed, nothing can be split by it anymore
+		if(j <= generator->processing) continue;
 		
-		if(active->adjacent){
-			for(uint32_t i = 0; i < active->adjacent->size(); i++){
-				BoundingBox* adjacent = active->adjacent->at(i);
-				if(!adjacent->reachable) parents.push_back(adjacent);
+		for(uint32_t z = grid.firstCells[j].y; z <= grid.lastCells[j].y; z++){
+			for(uint32_t x = grid.firstCells[j].x; x <= grid.lastCells[j].x; x++){
+				grid.cells[z * grid.width + x].push_back(j);
 			}
 		}
-		
-		parents.erase(parents.begin() + index);
 	}
 }
 
-void deleteUnreachable(std::vector<BoundingBox*>* bboxes){
-	for(uint32_t i = 0; i < bboxes->size(); i++){
-		if(!bboxes->at(i)->reachable){
-			bboxes->erase( bboxes->begin() + i );
-			i--;
+// height positions >= heightIndex of every object whose cells overlap a box, from least to greatest
+void queryObjectGrid(WalkmapGenerator* generator, BoundingBox* box, uint32_t heightIndex, std::vector<uint32_t>& candidates){
+	const ObjectGrid& grid = generator->grid;
+	
+	candidates.clear();
+	
+	glm::vec2 halfSize = box->size / 2.f + grid.padding;
+	glm::vec2 low = glm::vec2(box->position.x, box->position.z) - halfSize;
+	glm::vec2 high = glm::vec2(box->position.x, box->position.z) + halfSize;
+	
+	glm::uvec2 first, last;
+	getGridCells(grid, low, high, first, last);
+	
+	uint32_t query = ++generator->query;
+	
+	for(uint32_t z = first.y; z <= last.y; z++){
+		for(uint32_t x = first.x; x <= last.x; x++){
+			std::vector<uint32_t>& cell = generator->grid.cells[z * grid.width + x];
+			
+			for(uint32_t k = 0; k < cell.size(); k++){
+				uint32_t j = cell[k];
+				
+				// drop objects that have been processed (or are being processed) from the cell
+				if(j <= generator->processing){
+					cell[k] = cell.back();
+					cell.pop_back();
+					k--;
+					
+					continue;
+				}
+				
+				if(j < heightIndex || generator->queryStamps[j] == query) continue;
+				
+				generator->queryStamps[j] = query;
+				candidates.push_back(j);
+			}
 		}
 	}
+	
+	std::sort(candidates.begin(), candidates.end());
 }
 
-// generate walkmap from vector of objects into a vector of bounding boxes
-void generateWalkmap(WalkmapSettings& settings, std::vector<Object*>* objects, std::vector<BoundingBox*>* walkmap){
-	// the vectors below store indexes to the objects vector, indicating information about the object at that index
+// queryObjectGrid for any amount of threads at once, the grid is left alone and objects are checked against top instead of being activated (every object has to be in the grid already)
+// returns the same objects queryObjectGrid would have while processing the object at heightIndex-1 (top is its top face), since activation only depends on how high objects are above the object being processed
+void querySharedObjectGrid(const WalkmapGenerator* generator, WalkmapWorker* worker, BoundingBox* box, uint32_t heightIndex, float top, std::vector<uint32_t>& candidates){
+	const ObjectGrid& grid = generator->grid;
 	
-	// each object sorted by least to greatest y value
-	// starts with index 0
-	std::vector<uint32_t> sortedByHeight = {0};
+	candidates.clear();
 	
-	// each index of this vector is the indexes 
-	std::vector<std::vector<uint32_t>> collisionGroups(objects->size(), std::vector<uint32_t>());
+	if(worker->queryStamps.size() < generator->sortedByHeight.size()) worker->queryStamps.assign(generator->sortedByHeight.size(), 0);
 	
-	printf(" - Sorting objects by height...\n");
+	glm::vec2 halfSize = box->size / 2.f + grid.padding;
+	glm::vec2 low = glm::vec2(box->position.x, box->position.z) - halfSize;
+	glm::vec2 high = glm::vec2(box->position.x, box->position.z) + halfSize;
 	
-	// sort objects by height (based on the top face's height)
-	// binary sort (kinda)
-	for(uint32_t i = 1; i < objects->size(); i++){
-		uint32_t low = 0;
-		uint32_t high = sortedByHeight.size()-1;
-		uint32_t size = high-low+1;
-		uint32_t index = size / 2;
-		
-		Object* u = objects->at(i);
-		float us = u->position.y + u->scale.y/2.f;
-		
-		while(size > 2){
-			Object* t = objects->at(sortedByHeight[index]);
-			float them = t->position.y + t->scale.y/2.f;
-			
-			// determine direction of index change
-			int32_t direction = signum(us - them);
+	glm::uvec2 first, last;
+	getGridCells(grid, low, high, first, last);
+	
+	uint32_t query = ++worker->query;
+	
+	for(uint32_t z = first.y; z <= last.y; z++){
+		for(uint32_t x = first.x; x <= last.x; x++){
+			const std::vector<uint32_t>& cell = grid.cells[z * grid.width + x];
 			
-			if(direction == -1){
-				high = index-1;  
-			} else if(direction == 1){
-				low = index+1;
-			} else {
-				// exit early
-				size = 0;
-				break;
+			for(uint32_t j : cell){
+				if(j < heightIndex || worker->queryStamps[j] == query) continue;
+				
+				// wouldn't have been activated yet
+				if(generator->bottomsByHeight[j] - top >= generator->settings.playerHeight) continue;
+				
+				worker->queryStamps[j] = query;
+				candidates.push_back(j);
 			}
-			
-			size = high-low+1;
-			
-			// determine change in index
-			uint32_t change = size/2;
-			
-			index += direction * (1+change);
 		}
+	}
+	
+	std::sort(candidates.begin(), candidates.end());
+}
+
+// push the part of the collision group in groupStack[groupBegin, groupEnd) whose footprints overlap a box onto the group stack (the box is grown by the grid's padding so nothing bboxIntersection would count is missed)
+void narrowCollisionGroup(const WalkmapGenerator* generator, WalkmapWorker* worker, BoundingBox* box, uint32_t groupBegin, uint32_t groupEnd){
+	glm::vec2 halfSize = box->size / 2.f + generator->grid.padding;
+	glm::vec2 low = glm::vec2(box->position.x, box->position.z) - halfSize;
+	glm::vec2 high = glm::vec2(box->position.x, box->position.z) + halfSize;
+	
+	for(uint32_t c = groupBegin; c < groupEnd; c++){
+		uint32_t j = worker->groupStack[c];
+		uint32_t object = generator->sortedByHeight[j];
+		
+		glm::vec2 position = glm::vec2(generator->objects->positions[object].x, generator->objects->positions[object].z);
+		glm::vec2 objectHalfSize = glm::vec2(generator->objects->scales[object].x, generator->objects->scales[object].z) / 2.f;
+		
+		if(position.x + objectHalfSize.x < low.x || position.x - objectHalfSize.x > high.x) continue;
+		if(position.y + objectHalfSize.y < low.y || position.y - objectHalfSize.y > high.y) continue;
+		
+		worker->groupStack.push_back(j);
+	}
+}
+
+// compact walkmap
+uint32_t addCompactBox(CompactWalkmap* walkmap, glm::vec3 position, glm::vec2 size){
+	CompactBox box;
+	
+	box.x = position.x;
+	box.y = position.y;
+	box.z = position.z;
+	box.width = size.x;
+	box.depth = size.y;
+	
+	box.idStart = walkmap->ids.size();
+	box.idCount = 0;
+	
+	walkmap->boxes.push_back(box);
+	walkmap->offsets.push_back(walkmap->edges.size());
+	
+	return walkmap->boxes.size()-1;
+}
+
+std::string_view getCompactBoxId(const CompactWalkmap* walkmap, uint32_t box, uint32_t id){
+	const std::pair<uint32_t, uint32_t>& slice = walkmap->ids[walkmap->boxes[box].idStart + id];
+	
+	return std::string_view(walkmap->idPool.data() + slice.first, slice.second);
+}
+
+// copy boxes into a compact walkmap in order (adjacency keeps its order too), boxes that aren't in the vector can't be adjacent to the ones that are
+void compactWalkmap(std::vector<BoundingBox*>* boxes, CompactWalkmap* walkmap){
+	// number the boxes so adjacency can be written as indexes
+	for(uint32_t i = 0; i < boxes->size(); i++){
+		boxes->at(i)->reachable = walkmap->boxes.size() + i;
+	}
+	
+	walkmap->boxes.reserve(walkmap->boxes.size() + boxes->size());
+	walkmap->offsets.reserve(walkmap->offsets.size() + boxes->size());
+	
+	for(BoundingBox* box : *boxes){
+		uint32_t index = addCompactBox(walkmap, box->position, box->size);
 		
-		// sort using the remaining components, should be either 1 or 2
-		if(size == 1){
-			float them = objects->at(sortedByHeight[index])->position.y + objects->at(sortedByHeight[index])->scale.y/2.f;
+		for(BoundingBox* adjacent : *box->adjacent){
+			walkmap->edges.push_back(adjacent->reachable);
+		}
+		
+		walkmap->offsets.back() = walkmap->edges.size();
+		
+		for(std::string_view id : *box->ids){
+			walkmap->ids.push_back( std::make_pair(walkmap->idPool.length(), id.length()) );
+			walkmap->idPool += id;
+		}
+		
+		walkmap->boxes[index].idCount = box->ids->size();
+	}
+}
+
+// mark every box connected to start
+void markReachable(const CompactWalkmap* walkmap, uint32_t start, std::vector<bool>& reachable){
+	reachable.assign(walkmap->boxes.size(), false);
+	
+	std::vector<uint32_t> parents = {start};
+	reachable[start] = true;
+	
+	while(parents.size() > 0){
+		uint32_t active = parents.back();
+		parents.pop_back();
+		
+		for(uint32_t i = walkmap->offsets[active]; i < walkmap->offsets[active+1]; i++){
+			uint32_t adjacent = walkmap->edges[i];
 			
-			index += us > them;
-		} else if(size == 2){
-			// somewhat of a hack to make math work
-			index = high;
+			if(reachable[adjacent]) continue;
 			
-			float them1 = objects->at(sortedByHeight[low])->position.y + objects->at(sortedByHeight[low])->scale.y/2.f;
-			float them2 = objects->at(sortedByHeight[high])->position.y + objects->at(sortedByHeight[high])->scale.y/2.f;
+			reachable[adjacent] = true;
+			parents.push_back(adjacent);
+		}
+	}
+}
 
-			index += (us > them2) - (us < them1);
+// remove boxes that aren't reachable (keeps the order of everything else)
+void removeUnreachable(CompactWalkmap* walkmap, const std::vector<bool>& reachable){
+	CompactWalkmap compacted;
+	
+	// new index of every reachable box
+	std::vector<uint32_t> remap(walkmap->boxes.size(), UINT32_MAX);
+	uint32_t count = 0;
+	
+	for(uint32_t i = 0; i < walkmap->boxes.size(); i++){
+		if(reachable[i]) remap[i] = count++;
+	}
+	
+	compacted.boxes.reserve(count);
+	compacted.offsets.reserve(count+1);
+	
+	for(uint32_t i = 0; i < walkmap->boxes.size(); i++){
+		if(!reachable[i]) continue;
+		
+		const CompactBox& box = walkmap->boxes[i];
+		
+		uint32_t index = addCompactBox(&compacted, glm::vec3(box.x, box.y, box.z), glm::vec2(box.width, box.depth));
+		
+		// a reachable box is only ever adjacent to reachable boxes
+		for(uint32_t j = walkmap->offsets[i]; j < walkmap->offsets[i+1]; j++){
+			compacted.edges.push_back( remap[walkmap->edges[j]] );
 		}
+		
+		compacted.offsets.back() = compacted.edges.size();
+		
+		for(uint32_t j = 0; j < box.idCount; j++){
+			std::string_view id = getCompactBoxId(walkmap, i, j);
+			
+			compacted.ids.push_back( std::make_pair(compacted.idPool.length(), id.length()) );
+			compacted.idPool += id;
+		}
+		
+		compacted.boxes[index].idCount = box.idCount;
+	}
+	
+	*walkmap = std::move(compacted);
+}
 
-		sortedByHeight.insert(sortedByHeight.begin()+index, i);
+// center and size of a box along an axis (0 is x, 1 is z)
+static inline float& getBoxCenter(CompactBox& box, uint32_t axis){
+	return axis == 0 ? box.x : box.z;
+}
+
+static inline float& getBoxSize(CompactBox& box, uint32_t axis){
+	return axis == 0 ? box.width : box.depth;
+}
+
+static uint32_t findMergedBox(std::vector<uint32_t>& parents, uint32_t box){
+	while(parents[box] != box){
+		parents[box] = parents[parents[box]];
+		box = parents[box];
 	}
 	
-	// print sorted
+	return box;
+}
+
+// merge every run of boxes along an axis that have the same height, line up on the other axis and touch
+// merged boxes are kept in rects[] of whichever box came first, returns the amount of merges
+static uint32_t mergeBoxRows(std::vector<CompactBox>& rects, std::vector<uint32_t>& parents, uint32_t axis){
+	uint32_t other = 1 - axis;
+	
+	std::vector<uint32_t> rows;
 	
-	/*
-	for(uint32_t i = 0; i < sortedByHeight.size(); i++){
-		printf("%d, ", sortedByHeight[i]);
+	for(uint32_t i = 0; i < rects.size(); i++){
+		if(parents[i] == i) rows.push_back(i);
 	}
 	
-	printf("\n");
-	*/
+	if(rows.size() < 2) return 0;
 	
-	// calculate walkable space
-	printf(" - Calculating walkable space...\n");
+	// boxes in the same row end up next to each other, ordered along the axis
+	std::sort(rows.begin(), rows.end(), [&](uint32_t a, uint32_t b){
+		CompactBox& boxA = rects[a];
+		CompactBox& boxB = rects[b];
+		
+		if(boxA.y != boxB.y) return boxA.y < boxB.y;
+		if(getBoxCenter(boxA, other) != getBoxCenter(boxB, other)) return getBoxCenter(boxA, other) < getBoxCenter(boxB, other);
+		if(getBoxSize(boxA, other) != getBoxSize(boxB, other)) return getBoxSize(boxA, other) < getBoxSize(boxB, other);
+		if(getBoxCenter(boxA, axis) != getBoxCenter(boxB, axis)) return getBoxCenter(boxA, axis) < getBoxCenter(boxB, axis);
+		
+		return a < b;
+	});
 	
-	// loop through each object and call process
-	for(uint32_t i = 0; i < sortedByHeight.size(); i++){
-		// get this object
-		Object* obj1 = objects->at(sortedByHeight[i]);
+	uint32_t merges = 0;
+	uint32_t current = rows[0];
+	
+	for(uint32_t k = 1; k < rows.size(); k++){
+		uint32_t next = rows[k];
+		
+		CompactBox box = rects[current];
+		CompactBox& nextBox = rects[next];
+		
+		bool sameRow = box.y == nextBox.y && nearly_equal(getBoxCenter(box, other), getBoxCenter(nextBox, other)) && nearly_equal(getBoxSize(box, other), getBoxSize(nextBox, other));
 		
-		if(!obj1 || !obj1->bboxes) continue;
+		float low = getBoxCenter(box, axis) - getBoxSize(box, axis)/2.f;
+		float high = getBoxCenter(box, axis) + getBoxSize(box, axis)/2.f;
+		float nextLow = getBoxCenter(nextBox, axis) - getBoxSize(nextBox, axis)/2.f;
+		float nextHigh = getBoxCenter(nextBox, axis) + getBoxSize(nextBox, axis)/2.f;
 		
-		// create a bounding box for this object if necessary
-		if(obj1->bboxes->size() <= 0){
-			BoundingBox* bbox1 = objToBbox(obj1);
-			*obj1->bboxes = {bbox1};
+		if(!sameRow || !nearly_equal(high, nextLow)){
+			current = next;
+			continue;
 		}
 		
-		// recursively parse the object into bboxes
-		if(i+1 < sortedByHeight.size()) processObject(obj1, obj1->bboxes, objects, &sortedByHeight, i+1, settings);
+		getBoxCenter(box, axis) = (low + nextHigh) / 2.f;
+		getBoxSize(box, axis) = nextHigh - low;
 		
-		// give boxes ids, if desired
-		if(settings.generateIds){
-			for(uint32_t i = 0; i < obj1->bboxes->size(); i++){
-				BoundingBox* bbox = obj1->bboxes->at(i);
+		// the merged box takes the place of whichever box came first
+		uint32_t root = std::min(current, next);
+		
+		rects[root] = box;
+		parents[std::max(current, next)] = root;
+		
+		current = root;
+		merges++;
+	}
+	
+	return merges;
+}
+
+// greedily merge boxes that have the same height and share a full edge into larger boxes
+// merged boxes are adjacent to everything their parts were and have all of their ids, boxes keep the order of their first part
+void mergeBoxes(CompactWalkmap* walkmap){
+	uint32_t boxCount = walkmap->boxes.size();
+	
+	std::vector<CompactBox> rects = walkmap->boxes;
+	std::vector<uint32_t> parents(boxCount);
+	
+	for(uint32_t i = 0; i < boxCount; i++){
+		parents[i] = i;
+	}
+	
+	// merging along one axis can line boxes up along the other, so keep going until nothing changes
+	while(mergeBoxRows(rects, parents, 0) + mergeBoxRows(rects, parents, 1) > 0);
+	
+	// new index of every box (the same as every other part of the box it was merged into)
+	std::vector<uint32_t> remap(boxCount);
+	uint32_t count = 0;
+	
+	for(uint32_t i = 0; i < boxCount; i++){
+		uint32_t root = findMergedBox(parents, i);
+		
+		remap[i] = root == i ? count++ : remap[root];
+	}
+	
+	// parts of each merged box, in order
+	std::vector<uint32_t> partOffsets(count+1, 0);
+	std::vector<uint32_t> parts(boxCount);
+	
+	for(uint32_t i = 0; i < boxCount; i++){
+		partOffsets[remap[i]+1]++;
+	}
+	
+	for(uint32_t i = 0; i < count; i++){
+		partOffsets[i+1] += partOffsets[i];
+	}
+	
+	std::vector<uint32_t> nextPart(partOffsets.begin(), partOffsets.end()-1);
+	
+	for(uint32_t i = 0; i < boxCount; i++){
+		parts[nextPart[remap[i]]++] = i;
+	}
+	
+	CompactWalkmap merged;
+	
+	merged.boxes.reserve(count);
+	merged.offsets.reserve(count+1);
+	
+	// last box each box was linked to, to skip duplicate edges
+	std::vector<uint32_t> linked(count, UINT32_MAX);
+	
+	for(uint32_t i = 0; i < count; i++){
+		const CompactBox& box = rects[parts[partOffsets[i]]];
+		
+		uint32_t index = addCompactBox(&merged, glm::vec3(box.x, box.y, box.z), glm::vec2(box.width, box.depth));
+		linked[index] = index;
+		
+		uint32_t idCount = 0;
+		
+		for(uint32_t p = partOffsets[i]; p < partOffsets[i+1]; p++){
+			uint32_t part = parts[p];
+			
+			for(uint32_t j = walkmap->offsets[part]; j < walkmap->offsets[part+1]; j++){
+				uint32_t adjacent = remap[walkmap->edges[j]];
+				
+				if(linked[adjacent] == index) continue;
 				
-				if(bbox == NULL) continue;
+				linked[adjacent] = index;
+				merged.edges.push_back(adjacent);
+			}
+			
+			for(uint32_t j = 0; j < walkmap->boxes[part].idCount; j++){
+				std::string_view id = getCompactBoxId(walkmap, part, j);
 				
-				for(uint32_t j = 0; j < obj1->ids->size(); j++){
-					std::string id = obj1->ids->at(j);
+				merged.ids.push_back( std::make_pair(merged.idPool.length(), id.length()) );
+				merged.idPool += id;
+			}
+			
+			idCount += walkmap->boxes[part].idCount;
+		}
+		
+		merged.offsets.back() = merged.edges.size();
+		merged.boxes[index].idCount = idCount;
+	}
+	
+	*walkmap = std::move(merged);
+}
+
+// link every pair of boxes whose footprints touch (or overlap) and whose heights are at most stepHeight apart, replacing whatever adjacency the walkmap had
+// boxes are bucketed into a uniform grid so each box is only checked against the boxes near it, adjacent boxes are listed from least to greatest index
+void linkCompactBoxes(CompactWalkmap* walkmap, float stepHeight){
+	uint32_t boxCount = walkmap->boxes.size();
+	
+	walkmap->offsets.assign(1, 0);
+	walkmap->edges.clear();
+	
+	if(boxCount < 1) return;
+	
+	// same kind of grid as the one objects go in, see buildObjectGrid
+	ObjectGrid grid;
+	
+	glm::vec2 low = glm::vec2(FLT_MAX);
+	glm::vec2 high = glm::vec2(-FLT_MAX);
+	
+	std::vector<float> extents(boxCount);
+	
+	for(uint32_t i = 0; i < boxCount; i++){
+		const CompactBox& box = walkmap->boxes[i];
+		
+		glm::vec2 position = glm::vec2(box.x, box.z);
+		glm::vec2 halfSize = glm::vec2(box.width, box.depth) / 2.f;
+		
+		low = glm::min(low, position - halfSize);
+		high = glm::max(high, position + halfSize);
+		
+		// slivers left by splits would make the cells far too big if the longest side was used
+		extents[i] = std::sqrt(box.width * box.depth);
+	}
+	
+	glm::vec2 size = glm::max(high - low, glm::vec2(FLT_MIN));
+	
+	float largest = std::max( std::max(std::abs(low.x), std::abs(low.y)), std::max(std::abs(high.x), std::abs(high.y)) );
+	grid.padding = largest * 1e-4f + 1e-6f;
+	
+	std::nth_element(extents.begin(), extents.begin() + boxCount/2, extents.end());
+	
+	grid.cellSize = std::max( extents[boxCount/2], std::sqrt(size.x * size.y / boxCount) );
+	grid.cellSize = std::max(grid.cellSize, std::max(size.x, size.y) / 1024);
+	
+	grid.origin = low;
+	grid.width = std::max(1u, (uint32_t)std::ceil(size.x / grid.cellSize));
+	grid.depth = std::max(1u, (uint32_t)std::ceil(size.y / grid.cellSize));
+	
+	grid.cells.assign(grid.width * grid.depth, std::vector<uint32_t>());
+	
+	for(uint32_t i = 0; i < boxCount; i++){
+		const CompactBox& box = walkmap->boxes[i];
+		
+		glm::vec2 position = glm::vec2(box.x, box.z);
+		glm::vec2 halfSize = glm::vec2(box.width, box.depth) / 2.f;
+		
+		glm::uvec2 first, last;
+		getGridCells(grid, position - halfSize, position + halfSize, first, last);
+		
+		for(uint32_t z = first.y; z <= last.y; z++){
+			for(uint32_t x = first.x; x <= last.x; x++){
+				grid.cells[z * grid.width + x].push_back(i);
+			}
+		}
+	}
+	
+	// last box each box was checked against, so boxes in more than one cell are only checked once
+	std::vector<uint32_t> stamps(boxCount, UINT32_MAX);
+	std::vector<uint32_t> adjacent;
+	
+	for(uint32_t i = 0; i < boxCount; i++){
+		const CompactBox& box = walkmap->boxes[i];
+		
+		glm::vec2 position = glm::vec2(box.x, box.z);
+		glm::vec2 boxSize = glm::vec2(box.width, box.depth);
+		glm::vec2 halfSize = boxSize / 2.f + grid.padding;
+		
+		glm::uvec2 first, last;
+		getGridCells(grid, position - halfSize, position + halfSize, first, last);
+		
+		adjacent.clear();
+		
+		for(uint32_t z = first.y; z <= last.y; z++){
+			for(uint32_t x = first.x; x <= last.x; x++){
+				for(uint32_t j : grid.cells[z * grid.width + x]){
+					if(j == i || stamps[j] == i) continue;
+					
+					stamps[j] = i;
 					
-					int32_t index = obj1->children;
+					const CompactBox& other = walkmap->boxes[j];
 					
-					bbox->ids->push_back( id + std::to_string(index) );
+					if(!nearly_less_or_eq(std::abs(other.y - box.y), stepHeight)) continue;
 					
-					obj1->children++;
+					if(bboxIntersection(position, boxSize, glm::vec2(other.x, other.z), glm::vec2(other.width, other.depth))) adjacent.push_back(j);
 				}
 			}
 		}
+		
+		std::sort(adjacent.begin(), adjacent.end());
+		
+		walkmap->edges.insert(walkmap->edges.end(), adjacent.begin(), adjacent.end());
+		walkmap->offsets.push_back(walkmap->edges.size());
+	}
+}
+
+// sort a scene's objects by height and bucket them into the broadphase grid
+void initializeGenerator(WalkmapGenerator* generator, const WalkmapSettings& settings, const ObjectArrays* objects){
+	uint32_t objectCount = objects->positions.size();
+	
+	generator->objects = objects;
+	generator->settings = settings;
+	generator->bboxes.resize(objectCount);
+	generator->reachable.resize(objectCount, false);
+	
+	// each object sorted by least to greatest top face height, objects at the same height stay in scene order
+	printf(" - Sorting objects by height...\n");
+	
+	sortIndicesByKey(objects->tops.data(), objectCount, generator->sortedByHeight);
+	
+	// bottoms in height order for processObject
+	generator->bottomsByHeight.resize(objectCount);
+	
+	for(uint32_t i = 0; i < objectCount; i++){
+		generator->bottomsByHeight[i] = objects->bottoms[generator->sortedByHeight[i]];
+	}
+	
+	buildObjectGrid(generator);
+}
+
+// give an object's boxes ids made from the object's ids and how many boxes came before them
+static void nameObjectBoxes(const ObjectArrays* objects, uint32_t object, const std::vector<BoundingBox*>& bboxes){
+	int32_t children = 0;
+	
+	for(uint32_t i = 0; i < bboxes.size(); i++){
+		BoundingBox* bbox = bboxes[i];
+		
+		if(bbox == NULL) continue;
+		
+		for(uint32_t j = 0; j < objects->idCounts[object]; j++){
+			std::string id = std::string(getObjectId(objects, object, j));
+			
+			bbox->ids->push_back( copyToArena(getBoxArena(), id + std::to_string(children)) );
+			
+			children++;
+		}
+	}
+}
+
+// box processed as a task of its own when processing objects in parallel, tasks are put back together in the order processObject would've made everything by finishSplitTask
+struct SplitTask {
+	BoundingBox* box;
+	
+	// height position of the object the box belongs to
+	uint32_t heightIndex;
+	
+	// collision group the box is checked against (owned by the task that split its parent), NULL if the box is the object's own box (the group is queried then)
+	const std::vector<uint32_t>* group;
+	
+	// the box was split here, and the boxes it was split into are tasks of their own
+	bool split;
+	SplitEvent event;
+	
+	std::array<SplitTask*, 4> children;
+	uint32_t childCount;
+	
+	// collision group of the boxes it was split into
+	std::vector<uint32_t> childGroup;
+	
+	// otherwise the box was handed to processObject, boxes is what it ended up with (boxes[0] is the box itself, NULL if it was split) and splits are the splits it made
+	std::vector<BoundingBox*> boxes;
+	std::vector<SplitEvent> splits;
+};
+
+// tasks waiting to be run by a thread, the thread takes the newest task and other threads steal the oldest
+struct SplitTaskQueue {
+	std::mutex mutex;
+	std::deque<SplitTask*> tasks;
+};
+
+// threads processing objects in parallel and the tasks they share
+struct SplitTaskPool {
+	WalkmapGenerator* generator;
+	
+	// smallest collision group a box is given a task of its own for, boxes with smaller groups are processed on the spot
+	uint32_t cutoff;
+	
+	// one of each per thread
+	std::vector<SplitTaskQueue> queues;
+	std::vector<WalkmapWorker> workers;
+	std::vector<std::deque<SplitTask>> tasks;
+	
+	// tasks that have been queued but haven't finished yet
+	std::atomic<uint32_t> pending;
+};
+
+static void queueSplitTask(SplitTaskPool* pool, uint32_t thread, SplitTask* task){
+	pool->pending++;
+	
+	std::lock_guard<std::mutex> lock(pool->queues[thread].mutex);
+	pool->queues[thread].tasks.push_back(task);
+}
+
+// newest task of a thread's own queue, or the oldest task of another thread's queue if it's empty (NULL if every queue is empty)
+static SplitTask* takeSplitTask(SplitTaskPool* pool, uint32_t thread){
+	uint32_t threads = pool->queues.size();
+	
+	for(uint32_t i = 0; i < threads; i++){
+		SplitTaskQueue& queue = pool->queues[(thread + i) % threads];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		
+		if(queue.tasks.empty()) continue;
+		
+		SplitTask* task;
+		
+		if(i == 0){
+			task = queue.tasks.back();
+			queue.tasks.pop_back();
+		} else {
+			task = queue.tasks.front();
+			queue.tasks.pop_front();
+		}
+		
+		return task;
+	}
+	
+	return NULL;
+}
+
+// hand a task's box to processObject, its collision group has to be on the bottom of the group stack
+static void processSplitTaskBox(WalkmapGenerator* generator, WalkmapWorker* worker, uint32_t owner, SplitTask* task, uint32_t groupEnd){
+	task->boxes = {task->box};
+	worker->splits = &task->splits;
+	
+	processObject(generator, worker, owner, &task->boxes, 0, 1, 0, groupEnd);
+}
+
+// check a task's box against its collision group, the same way processObject does
+// if the group is big enough the box is split here and the boxes it's split into are queued as tasks of their own, otherwise processObject handles the whole thing
+static void runSplitTask(SplitTaskPool* pool, uint32_t thread, SplitTask* task){
+	WalkmapGenerator* generator = pool->generator;
+	WalkmapWorker* worker = &pool->workers[thread];
+	
+	uint32_t owner = generator->sortedByHeight[task->heightIndex];
+	
+	// the group goes on the bottom of the group stack
+	if(task->group == NULL){
+		querySharedObjectGrid(generator, worker, task->box, task->heightIndex+1, generator->objects->tops[owner], worker->groupStack);
+	} else {
+		worker->groupStack.assign(task->group->begin(), task->group->end());
+	}
+	
+	uint32_t groupEnd = worker->groupStack.size();
+	
+	task->split = false;
+	
+	if(groupEnd < pool->cutoff){
+		processSplitTaskBox(generator, worker, owner, task, groupEnd);
+		
+		return;
+	}
+	
+	for(uint32_t c = 0; c < groupEnd; c++){
+		uint32_t obj2 = generator->sortedByHeight[worker->groupStack[c]];
+		BoundingBox* bbox2 = generator->bboxes[obj2][0];
+		
+		if(!bboxIntersection(task->box, bbox2)) continue;
+		
+		task->split = true;
+		task->event.original = task->box;
+		task->event.splitter = obj2;
+		splitBbox(&task->event.result, task->box, bbox2, generator->settings.splitStrategy);
+		
+		// c+1 to ignore the object we just went over
+		narrowCollisionGroup(generator, worker, task->box, c+1, groupEnd);
+		task->childGroup.assign(worker->groupStack.begin() + groupEnd, worker->groupStack.end());
+		
+		task->childCount = 0;
+		
+		for(uint32_t k = 0; k < task->event.result.count; k++){
+			if(!isSplitBoxLive(task->event.result, k)) continue;
+			
+			SplitTask* child = &pool->tasks[thread].emplace_back();
+			child->box = task->event.result.boxes[k];
+			child->heightIndex = task->heightIndex;
+			child->group = &task->childGroup;
+			
+			task->children[task->childCount++] = child;
+		}
+		
+		// children with small groups are handed to processObject on the spot instead of being queued
+		for(uint32_t k = 0; k < task->childCount; k++){
+			SplitTask* child = task->children[k];
+			
+			if(task->childGroup.size() >= pool->cutoff){
+				queueSplitTask(pool, thread, child);
+			} else {
+				worker->groupStack.assign(task->childGroup.begin(), task->childGroup.end());
+				child->split = false;
+				
+				processSplitTaskBox(generator, worker, owner, child, task->childGroup.size());
+			}
+		}
+		
+		return;
+	}
 	
-		/*
-		// print
-		printf("bboxes for object %d (%f, %f, %f):\n", sortedByHeight[i], obj1->position.x, obj1->position.y, obj1->position.z);
+	// nothing in the group touches the box
+	task->boxes = {task->box};
+}
+
+// run tasks on one of the threads started by processObjectsInParallel until every task is done
+static void runSplitTasks(SplitTaskPool* pool, uint32_t thread, BoxArena* arena){
+	setBoxArena(arena);
+	
+	while(pool->pending > 0){
+		SplitTask* task = takeSplitTask(pool, thread);
 		
+		// whatever's left is still running on other threads (and might queue more tasks)
+		if(task == NULL){
+			std::this_thread::yield();
+			continue;
+		}
+		
+		runSplitTask(pool, thread, task);
 		
-		for(uint32_t i = 0; i < obj1->bboxes->size(); i++){
-			BoundingBox* box = obj1->bboxes->at(i);
+		pool->pending--;
+	}
+	
+	setBoxArena(NULL);
+}
+
+// box a task's box ended up as in its object's boxes (NULL if it was split)
+static inline BoundingBox* getSplitTaskBox(const SplitTask* task){
+	return task->split ? NULL : task->boxes[0];
+}
+
+// link the splits a task made and append the boxes it added to its object's boxes, both in the order processObject would've done them in
+// processObject appends the boxes a box is split into and then processes each of them before moving on to the next box, so everything a box adds comes right after the boxes it was split into
+// the task tree is walked with a stack instead of recursing, children are pushed last to first so they're still finished first to last
+static void finishSplitTask(WalkmapGenerator* generator, SplitTask* root, std::vector<BoundingBox*>& bboxes){
+	std::vector<SplitTask*> stack = {root};
+	
+	while(!stack.empty()){
+		SplitTask* task = stack.back();
+		stack.pop_back();
+		
+		if(!task->split){
+			for(SplitEvent& split : task->splits){
+				linkSplit(generator, split.original, split.splitter, &split.result);
+			}
 			
-			//if(box == NULL) continue;
-			if(box == NULL){ printf("NULL box\n"); continue; }
+			bboxes.insert(bboxes.end(), task->boxes.begin() + 1, task->boxes.end());
 			
-			printf("%d: pos: %f, %f, %f, size: %f, %f, numAdjacent: %d\n", i+1, box->position.x, box->position.y, box->position.z, box->size.x, box->size.y, box->adjacent->size());
+			continue;
 		}
 		
-		printf("\n");
-		*/
+		linkSplit(generator, task->event.original, task->event.splitter, &task->event.result);
+		
+		for(uint32_t k = 0; k < task->childCount; k++){
+			bboxes.push_back(getSplitTaskBox(task->children[k]));
+		}
+		
+		for(uint32_t k = task->childCount; k > 0; k--){
+			stack.push_back(task->children[k-1]);
+		}
+	}
+}
+
+// process every object on more than one thread, boxes end up in the same order with the same adjacency as processing them on one thread
+// every object starts out as a task, and boxes with large enough collision groups are split into tasks of their own (so one object with a lot on top of it is spread over every thread too), threads steal tasks from each other once they run out
+// the boxes an object is split into don't depend on any other object being processed first, but links to other objects' boxes do, so tasks only record their splits and the splits are linked afterwards in height order
+// boxes are created in an arena for each thread (added to arenas), which have to outlive the boxes
+static void processObjectsInParallel(WalkmapGenerator* generator, uint32_t threads, std::vector<BoxArena*>& arenas, std::vector<BoundingBox*>& boxes){
+	const ObjectArrays* objects = generator->objects;
+	uint32_t objectCount = generator->sortedByHeight.size();
+	
+	// every object's box is created up front, since they can't be created as they're needed once threads are splitting with them
+	for(uint32_t i = 0; i < objectCount; i++){
+		generator->bboxes[i] = {objToBbox(objects, i)};
+	}
+	
+	// querySharedObjectGrid needs every object in the grid
+	activateObjects(generator, INFINITY);
+	
+	SplitTaskPool pool;
+	pool.generator = generator;
+	pool.cutoff = std::max(1u, generator->settings.splitTaskCutoff);
+	pool.queues = std::vector<SplitTaskQueue>(threads);
+	pool.workers.resize(threads);
+	pool.tasks.resize(threads);
+	pool.pending = 0;
+	
+	// each thread starts with an even share of the objects
+	std::vector<SplitTask> objectTasks(objectCount);
+	
+	for(uint32_t i = 0; i < objectCount; i++){
+		SplitTask* task = &objectTasks[i];
+		task->box = generator->bboxes[generator->sortedByHeight[i]][0];
+		task->heightIndex = i;
+		task->group = NULL;
+		
+		queueSplitTask(&pool, (uint64_t)i * threads / objectCount, task);
+	}
+	
+	std::vector<std::thread> threadPool;
+	
+	for(uint32_t i = 0; i < threads; i++){
+		arenas.push_back(createBoxArena());
+		
+		threadPool.push_back( std::thread(runSplitTasks, &pool, i, arenas.back()) );
+	}
+	
+	for(std::thread& thread : threadPool) thread.join();
+	
+	// link each object's splits in the order they were made, objects in height order (the same order linkSplit is called in on one thread)
+	std::vector<BoundingBox*> obj1Bboxes;
+	
+	for(uint32_t i = 0; i < objectCount; i++){
+		uint32_t obj1 = generator->sortedByHeight[i];
+		
+		obj1Bboxes = {getSplitTaskBox(&objectTasks[i])};
+		finishSplitTask(generator, &objectTasks[i], obj1Bboxes);
+		
+		// give boxes ids, if desired
+		if(generator->settings.generateIds) nameObjectBoxes(objects, obj1, obj1Bboxes);
 		
 		// write all of the boxes to the walkmap
-		walkmap->insert(walkmap->end(), obj1->bboxes->begin(), obj1->bboxes->end());
+		boxes.insert(boxes.end(), obj1Bboxes.begin(), obj1Bboxes.end());
 	}
+}
+
+// generate walkmap from a scene's objects into a vector of bounding boxes
+void generateWalkmap(WalkmapSettings& settings, const ObjectArrays* objects, CompactWalkmap* walkmap){
+	uint32_t objectCount = objects->positions.size();
 	
-	// strip null boxes
-	for(uint32_t i = 0; i < walkmap->size(); i++){
-		if(walkmap->at(i) == NULL){
-			walkmap->erase( walkmap->begin()+i );
-			i--;
+	if(objectCount < 1){
+		printf("No boxes were generated.\n");
+		return;
+	}
+	
+	if(settings.engine == WALKMAP_ENGINE_RASTER){
+		generateRasterWalkmap(settings, objects, walkmap);
+		return;
+	}
+	
+	if(settings.engine == WALKMAP_ENGINE_SWEEP){
+		generateSweepWalkmap(settings, objects, walkmap);
+		return;
+	}
+	
+	// boxes only live until they're compacted, so they get an arena of their own
+	BoxArena* previousArena = getBoxArena();
+	BoxArena* arena = createBoxArena();
+	setBoxArena(arena);
+	
+	WalkmapGenerator generator;
+	initializeGenerator(&generator, settings, objects);
+	
+	std::vector<uint32_t>& sortedByHeight = generator.sortedByHeight;
+	
+	// every box, in the order they'll be written
+	std::vector<BoundingBox*> boxes;
+	
+	// arenas of any threads boxes were created on
+	std::vector<BoxArena*> threadArenas;
+	
+	uint32_t threads = settings.threads;
+	
+	if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	
+	// no point in having more threads than objects
+	threads = std::min(threads, objectCount);
+	
+	// calculate walkable space
+	if(threads > 1){
+		printf(" - Calculating walkable space on %u threads...\n", threads);
+		
+		processObjectsInParallel(&generator, threads, threadArenas, boxes);
+	} else {
+		printf(" - Calculating walkable space...\n");
+		
+		WalkmapWorker worker;
+		
+		// loop through each object and call process
+		for(uint32_t i = 0; i < sortedByHeight.size(); i++){
+			// get this object
+			uint32_t obj1 = sortedByHeight[i];
+			std::vector<BoundingBox*>& obj1Bboxes = generator.bboxes[obj1];
+			
+			// create a bounding box for this object if necessary
+			if(obj1Bboxes.size() <= 0){
+				obj1Bboxes = {objToBbox(objects, obj1)};
+			}
+			
+			// recursively parse the object into bboxes
+			generator.processing = i;
+			activateObjects(&generator, objects->tops[obj1]);
+			
+			// objects that could intersect this object are only looked up once, the boxes it gets split into are only checked against them
+			// objects whose bottom face is at least the player height above this object's top face aren't in the group at all (they have no effect on its walkable space)
+			if(i+1 < sortedByHeight.size()){
+				queryObjectGrid(&generator, obj1Bboxes[0], i+1, worker.groupStack);
+				
+				processObject(&generator, &worker, obj1, &obj1Bboxes, 0, obj1Bboxes.size(), 0, worker.groupStack.size());
+			}
+			
+			// give boxes ids, if desired
+			if(settings.generateIds) nameObjectBoxes(objects, obj1, obj1Bboxes);
+			
+			// write all of the boxes to the walkmap
+			boxes.insert(boxes.end(), obj1Bboxes.begin(), obj1Bboxes.end());
 		}
 	}
 	
-	if(walkmap->size() < 1){
+	// strip null boxes
+	boxes.erase( std::remove(boxes.begin(), boxes.end(), (BoundingBox*)NULL), boxes.end() );
+	
+	if(boxes.size() < 1){
 		printf("No boxes were generated.\n");
+		
+		for(BoxArena* threadArena : threadArenas) destroyBoxArena(threadArena);
+		destroyBoxArena(arena);
+		setBoxArena(previousArena);
+		
 		return;
 	}
 	
+	compactWalkmap(&boxes, walkmap);
+	
+	if(settings.adjacency == WALKMAP_ADJACENCY_POST){
+		printf(" - Linking boxes...\n");
+		
+		linkCompactBoxes(walkmap, settings.stepHeight);
+	}
+	
+	// the pointer graph isn't needed anymore
+	boxes.clear();
+	generator.bboxes.clear();
+	
+	for(BoxArena* threadArena : threadArenas) destroyBoxArena(threadArena);
+	destroyBoxArena(arena);
+	setBoxArena(previousArena);
+	
+	finishWalkmap(settings, walkmap);
+}
+
+// remove boxes the player can't get to from the first box (and merge boxes, if desired)
+void finishWalkmap(WalkmapSettings& settings, CompactWalkmap* walkmap){
 	// eliminate unreachable boxes
-	//printf(" - Eliminating unreachable boxes...\n");
 	printf(" - Determining reachable boxes...\n");
 	
-	// recurse through all bboxes indirectly adjacent to the first one
-	//pushBboxes(walkmap->at(0));
-	pushBboxesNoRecurse(walkmap->at(0));
+	// everything indirectly adjacent to the first box
+	std::vector<bool> reachable;
+	markReachable(walkmap, 0, reachable);
 	
 	// remove unreachable
 	printf(" - Removing unreachable boxes...\n");
 	
-	deleteUnreachable(walkmap);
+	removeUnreachable(walkmap, reachable);
+	
+	if(settings.mergeBoxes){
+		printf(" - Merging boxes...\n");
+		
+		size_t before = walkmap->boxes.size();
+		
+		mergeBoxes(walkmap);
+		
+		printf(" - Merged %zu boxes into %zu\n", before, walkmap->boxes.size());
+	}
 }
 
 // convert walkmap (vector of BoundingBox*s) to a string to be written to a file
 // does not overwrite existing data in buffer
-void walkmapToBuffer(std::string& buffer, std::vector<BoundingBox*>* walkmap, WalkmapSettings& settings){
+void walkmapToBuffer(std::string& buffer, const CompactWalkmap* walkmap, WalkmapSettings& settings){
 	// .walkmap files are just .world files without anything extra
 	// the block syntax for walkmap boxes is as follows:
 	/*
@@ -386,15 +1270,10 @@ void walkmapToBuffer(std::string& buffer, std::vector<BoundingBox*>* walkmap, Wa
 	buffer += blockClose;
 	buffer += '\n';
 	
-	// next iterate through walkmap and assign each box an index (overriding the splitIndex value because I'm lazy)
-	// the walkmap uses indexes for adjacency information
-	for(uint32_t i = 0; i < walkmap->size(); i++){
-		walkmap->at(i)->reachable = i;
-	}
-	
-	for(uint32_t i = 0; i < walkmap->size(); i++){
+	// the walkmap uses indexes for adjacency information, same as CompactWalkmap
+	for(uint32_t i = 0; i < walkmap->boxes.size(); i++){
 		// get box
-		BoundingBox* box = walkmap->at(i);
+		const CompactBox& box = walkmap->boxes[i];
 		
 		// temp buffer for block
 		std::string blockBuffer;
@@ -403,11 +1282,12 @@ void walkmapToBuffer(std::string& buffer, std::vector<BoundingBox*>* walkmap, Wa
 		blockBuffer += delimiter;
 		
 		// add ids
-		if(box->ids->size() > 0){
+		if(box.idCount > 0){
 			blockBuffer += idsOpen;
 			
-			for(uint32_t j = 0; j < box->ids->size(); j++){
-				blockBuffer += box->ids->at(j) + parameterDelimiter;
+			for(uint32_t j = 0; j < box.idCount; j++){
+				blockBuffer += getCompactBoxId(walkmap, i, j);
+				blockBuffer += parameterDelimiter;
 			}
 			
 			blockBuffer += idsClose;
@@ -418,14 +1298,14 @@ void walkmapToBuffer(std::string& buffer, std::vector<BoundingBox*>* walkmap, Wa
 		
 		// add floats to block buffer
 		for(uint32_t j = 0; j < 5; j++){
-			float f = (&box->position[0])[j];
+			float f = (&box.x)[j];
 			
 			blockBuffer += std::to_string(f) + parameterDelimiter;
 		}
 		
 		// add adjacent boxes
-		for(uint32_t j = 0; j < box->adjacent->size(); j++){
-			blockBuffer += std::to_string(box->adjacent->at(j)->reachable) + parameterDelimiter;
+		for(uint32_t j = walkmap->offsets[i]; j < walkmap->offsets[i+1]; j++){
+			blockBuffer += std::to_string(walkmap->edges[j]) + parameterDelimiter;
 		}
 		
 		// add block close
@@ -437,7 +1317,7 @@ void walkmapToBuffer(std::string& buffer, std::vector<BoundingBox*>* walkmap, Wa
 }
 
 // does not overwrite existing data in buffer
-void walkmapToWorld(std::string& buffer, std::vector<BoundingBox*>* walkmap, WalkmapSettings& settings){
+void walkmapToWorld(std::string& buffer, const CompactWalkmap* walkmap, WalkmapSettings& settings){
 	const char delimiter = '$';
 	const char settingsDelimiter = '@';
 	const char parameterDelimiter = ',';
@@ -457,9 +1337,9 @@ void walkmapToWorld(std::string& buffer, std::vector<BoundingBox*>* walkmap, Wal
 	buffer += "# texture initialization blocks\n\n%[./textures/grid.png, default]\n\n# vertex data initialization blocks\n\n*[cube, cube]\n\n# light blocks\n\n&[0, 0, 0,     1, 1, 1,    1, 0, 0,     0.8, 0]\n\n# bbox object blocks\n\n";
 
 	// write bbox objects
-	for(uint32_t i = 0; i < walkmap->size(); i++){
+	for(uint32_t i = 0; i < walkmap->boxes.size(); i++){
 		// get box
-		BoundingBox* box = walkmap->at(i);
+		const CompactBox& box = walkmap->boxes[i];
 		
 		// temp buffer for block
 		std::string blockBuffer;
@@ -468,11 +1348,12 @@ void walkmapToWorld(std::string& buffer, std::vector<BoundingBox*>* walkmap, Wal
 		blockBuffer += delimiter;
 		
 		// add ids
-		if(box->ids->size() > 0){
+		if(box.idCount > 0){
 			blockBuffer += idsOpen;
 			
-			for(uint32_t j = 0; j < box->ids->size(); j++){
-				blockBuffer += box->ids->at(j) + parameterDelimiter;
+			for(uint32_t j = 0; j < box.idCount; j++){
+				blockBuffer += getCompactBoxId(walkmap, i, j);
+				blockBuffer += parameterDelimiter;
 			}
 			
 			blockBuffer += idsClose;
@@ -483,7 +1364,7 @@ void walkmapToWorld(std::string& buffer, std::vector<BoundingBox*>* walkmap, Wal
 		
 		// add floats to block buffer
 		for(uint32_t j = 0; j < 3; j++){
-			float f = (&box->position[0])[j];
+			float f = (&box.x)[j];
 			
 			blockBuffer += std::to_string(f) + parameterDelimiter;
 		}
@@ -491,7 +1372,7 @@ void walkmapToWorld(std::string& buffer, std::vector<BoundingBox*>* walkmap, Wal
 		// add zero for rotation
 		blockBuffer += "0,0,0,";
 		
-		blockBuffer += std::to_string(box->size.x) + ",0," + std::to_string(box->size.y) + ",default,cube";
+		blockBuffer += std::to_string(box.width) + ",0," + std::to_string(box.depth) + ",default,cube";
 		
 		// add block close
 		blockBuffer += blockClose;
@@ -501,6 +1382,75 @@ void walkmapToWorld(std::string& buffer, std::vector<BoundingBox*>* walkmap, Wal
 	}
 }
 
+// box arenas
+// blocks are big enough for thousands of boxes, anything bigger than a block gets a block of its own
+const size_t boxArenaBlockSize = 1 << 20;
+
+static thread_local BoxArena* currentBoxArena = NULL;
+
+BoxArena* createBoxArena(){
+	BoxArena* arena = new BoxArena();
+	
+	arena->used = boxArenaBlockSize;
+	
+	return arena;
+}
+
+void destroyBoxArena(BoxArena* arena){
+	for(char* block : arena->blocks){
+		free(block);
+	}
+	
+	if(currentBoxArena == arena) currentBoxArena = NULL;
+	
+	delete arena;
+}
+
+void* allocateFromArena(BoxArena* arena, size_t size, size_t alignment){
+	size_t offset = (arena->used + alignment-1) & ~(alignment-1);
+	
+	if(size > boxArenaBlockSize){
+		// own block, inserted before the last one so the last one keeps being bumped
+		char* block = (char*)malloc(size);
+		
+		arena->blocks.insert(arena->blocks.end() - (arena->blocks.size() > 0), block);
+		
+		return block;
+	}
+	
+	if(offset + size > boxArenaBlockSize){
+		arena->blocks.push_back( (char*)malloc(boxArenaBlockSize) );
+		offset = 0;
+	}
+	
+	arena->used = offset + size;
+	
+	return arena->blocks.back() + offset;
+}
+
+std::string_view copyToArena(BoxArena* arena, std::string_view str){
+	char* copy = (char*)allocateFromArena(arena, str.length(), 1);
+	
+	memcpy(copy, str.data(), str.length());
+	
+	return std::string_view(copy, str.length());
+}
+
+void setBoxArena(BoxArena* arena){
+	currentBoxArena = arena;
+}
+
+// boxes created without an arena set go into one that lives as long as the thread does
+BoxArena* getBoxArena(){
+	if(currentBoxArena == NULL){
+		static thread_local std::unique_ptr<BoxArena, void(*)(BoxArena*)> defaultArena(createBoxArena(), destroyBoxArena);
+		
+		currentBoxArena = defaultArena.get();
+	}
+	
+	return currentBoxArena;
+}
+
 // create bounding box with 2d position
 BoundingBox* createBbox(glm::vec2 p, glm::vec2 s){
 	return createBbox(glm::vec3(p.x, 0, p.y), s);
@@ -508,19 +1458,21 @@ BoundingBox* createBbox(glm::vec2 p, glm::vec2 s){
 
 // create bounding box with 3d position
 BoundingBox* createBbox(glm::vec3 p, glm::vec2 s){
+	BoxArena* arena = getBoxArena();
+	
 	// allocate space for box
-	BoundingBox* box = allocateMemoryForType<BoundingBox>();
+	BoundingBox* box = (BoundingBox*)allocateFromArena(arena, sizeof(BoundingBox), alignof(BoundingBox));
 	box->position = p;
 	box->size = s;
 	
 	generateBboxCorners(box);
 	
-	box->adjacent = new std::vector<BoundingBox*>();
+	box->adjacent = new (allocateFromArena(arena, sizeof(BoxAdjacency), alignof(BoxAdjacency))) BoxAdjacency(ArenaAllocator<BoundingBox*>(arena));
 	
 	//box->splitIndex = -1;
 	box->reachable = 0;
 	
-	box->ids = new std::vector<std::string>();
+	box->ids = new (allocateFromArena(arena, sizeof(BoxIds), alignof(BoxIds))) BoxIds(ArenaAllocator<std::string_view>(arena));
 	
 	return box;
 }
@@ -529,8 +1481,11 @@ BoundingBox* createBbox(BoundingBox* original){
 	return createBbox(original->position, original->size);
 }
 
-BoundingBox* objToBbox(Object* obj){
-	return createBbox( glm::vec3(obj->position.x, obj->position.y + obj->scale.y/2.f, obj->position.z), glm::vec2(obj->scale.x, obj->scale.z) );
+BoundingBox* objToBbox(const ObjectArrays* objects, uint32_t index){
+	glm::vec3 position = objects->positions[index];
+	glm::vec3 scale = objects->scales[index];
+	
+	return createBbox( glm::vec3(position.x, objects->tops[index], position.z), glm::vec2(scale.x, scale.z) );
 }
 
 void generateBboxCorners(BoundingBox* box){
@@ -546,13 +1501,6 @@ void generateBboxCorners(BoundingBox* box){
 	box->BR = BR;
 }
 
-void destroyBbox(BoundingBox* b){
-	delete b->adjacent;
-	delete b->ids;
-	
-	free(b);
-}
-
 // FIXME: doesn't account for rotation
 bool bboxIntersection(glm::vec2 p1, glm::vec2 s1, glm::vec2 p2, glm::vec2 s2){
 	return (
@@ -591,15 +1539,14 @@ void moveAndResizeBbox(BoundingBox* original, glm::vec3 newPosition, glm::vec2 n
 	generateBboxCorners(original);
 }
 
-// splits an AABB into multiple AABBs around a splitter AABB
-// newBoxes will always have either 1 value (if the original is returned) or 4 values, some of which may be NULL
-void splitBbox(std::vector<BoundingBox*>* newBoxes, BoundingBox* original, BoundingBox* splitter){
-	// if boxes are not intersecting, return original
-	if(!bboxIntersection(original, splitter)){
-		*newBoxes = {createBbox(original)};
-		return;
-	}
-	
+// positions and sizes of the boxes a split produces, before empty ones are dropped
+struct SplitLayout {
+	std::array<glm::vec2, 4> positions;
+	std::array<glm::vec2, 4> sizes;
+};
+
+// splits bboxes into a pinwheel pattern (each box takes one corner and one side of the splitter)
+static void splitBboxPinwheel(SplitLayout* layout, BoundingBox* original, BoundingBox* splitter){
 	//printf("original: UL: %f, %f, UR: %f, %f, BL: %f, %f, BR: %f, %f\n", original->UL.x, original->UL.y, original->UR.x, original->UR.y, original->BL.x, original->BL.y, original->BR.x, original->BR.y);
 	//printf("splitter: UL: %f, %f, UR: %f, %f, BL: %f, %f, BR: %f, %f\n", splitter->UL.x, splitter->UL.y, splitter->UR.x, splitter->UR.y, splitter->BL.x, splitter->BL.y, splitter->BR.x, splitter->BR.y);
 	
@@ -616,7 +1563,8 @@ void splitBbox(std::vector<BoundingBox*>* newBoxes, BoundingBox* original, Bound
 	
 	p1.x = std::min(p1.x, original->position.x);
 	
-	BoundingBox* box1 = createBbox(glm::vec3( p1.x, original->position.y, p1.y), s1);
+	layout->positions[0] = p1;
+	layout->sizes[0] = s1;
 	
 	/*
 	var w2 = og_UR.x - n_BR.x;
@@ -631,7 +1579,8 @@ void splitBbox(std::vector<BoundingBox*>* newBoxes, BoundingBox* original, Bound
 	
 	p2.y = std::min(p2.y, original->position.z);
 	
-	BoundingBox* box2 = createBbox(glm::vec3(p2.x, original->position.y, p2.y), s2);
+	layout->positions[1] = p2;
+	layout->sizes[1] = s2;
 	
 	/*
 	var w3 = og_BR.x - n_BL.x;
@@ -646,7 +1595,8 @@ void splitBbox(std::vector<BoundingBox*>* newBoxes, BoundingBox* original, Bound
 	
 	p3.x = std::max(splitter->BL.x + s3.x/2.f, original->position.x);
 	
-	BoundingBox* box3 = createBbox(glm::vec3(p3.x, original->position.y, p3.y), s3);
+	layout->positions[2] = p3;
+	layout->sizes[2] = s3;
 	
 	/*
 	var w4 = n_UL.x - og_BL.x;
@@ -662,29 +1612,96 @@ void splitBbox(std::vector<BoundingBox*>* newBoxes, BoundingBox* original, Bound
 	p4.x = std::min(p4.x, original->position.x);
 	p4.y = std::max(p4.y, original->position.z);
 	
-	BoundingBox* box4 = createBbox(glm::vec3(p4.x, original->position.y, p4.y), s4);
+	layout->positions[3] = p4;
+	layout->sizes[3] = s4;
+}
+
+// splits bboxes into an anvil pattern (long on top and bottom, short on sides)
+static void splitBboxAnvil(SplitLayout* layout, BoundingBox* original, BoundingBox* splitter){
+	// part of the splitter inside of original
+	glm::vec2 low = glm::max(original->UL, splitter->UL);
+	glm::vec2 high = glm::min(original->BR, splitter->BR);
+	
+	// top (full width)
+	glm::vec2 s1 = glm::vec2(original->size.x, low.y - original->UL.y);
+	layout->positions[0] = glm::vec2(original->position.x, original->UL.y + s1.y/2.f);
+	layout->sizes[0] = s1;
+	
+	// right (between top and bottom)
+	glm::vec2 s2 = glm::vec2(original->BR.x - high.x, high.y - low.y);
+	layout->positions[1] = glm::vec2(high.x + s2.x/2.f, low.y + s2.y/2.f);
+	layout->sizes[1] = s2;
+	
+	// bottom (full width)
+	glm::vec2 s3 = glm::vec2(original->size.x, original->BR.y - high.y);
+	layout->positions[2] = glm::vec2(original->position.x, high.y + s3.y/2.f);
+	layout->sizes[2] = s3;
+	
+	// left (between top and bottom)
+	glm::vec2 s4 = glm::vec2(low.x - original->UL.x, high.y - low.y);
+	layout->positions[3] = glm::vec2(original->UL.x + s4.x/2.f, low.y + s4.y/2.f);
+	layout->sizes[3] = s4;
+}
+
+// amount of boxes a layout keeps
+static uint32_t measureSplitLayout(const SplitLayout& layout){
+	uint32_t count = 0;
 	
-	// assign boxes
-	*newBoxes = {box1, box2, box3, box4};
+	for(uint32_t i = 0; i < 4; i++){
+		glm::vec2 size = layout.sizes[i];
+		
+		if(size.x <= 0 || size.y <= 0) continue;
+		
+		count++;
+	}
+	
+	return count;
+}
+
+// splits an AABB into multiple AABBs around a splitter AABB
+// newBoxes will always have either 1 box (if the original is returned) or 4 boxes, some of which may not be live
+// the 4 boxes go around the splitter in order, so each one touches the next (they aren't marked adjacent, see linkSplitBoxes)
+void splitBbox(SplitResult* newBoxes, BoundingBox* original, BoundingBox* splitter, SplitStrategy strategy){
+	// if boxes are not intersecting, return original
+	if(!bboxIntersection(original, splitter)){
+		newBoxes->boxes = {createBbox(original), NULL, NULL, NULL};
+		newBoxes->count = 1;
+		newBoxes->live = 1;
+		return;
+	}
+	
+	SplitLayout layout;
+	
+	if(strategy == SPLIT_STRATEGY_ANVIL){
+		splitBboxAnvil(&layout, original, splitter);
+	} else {
+		splitBboxPinwheel(&layout, original, splitter);
+	}
+	
+	// auto only uses anvil if it leaves less boxes, pinwheel is kept on ties
+	if(strategy == SPLIT_STRATEGY_AUTO){
+		SplitLayout anvil;
+		splitBboxAnvil(&anvil, original, splitter);
+		
+		if(measureSplitLayout(anvil) < measureSplitLayout(layout)) layout = anvil;
+	}
+	
+	newBoxes->boxes = {NULL, NULL, NULL, NULL};
+	newBoxes->count = 4;
+	newBoxes->live = 0;
 	
 	// some final operation to ensure new boxes are valid (some may have negative scale components or be too large)
-	for(uint32_t i = 0; i < newBoxes->size(); i++){
-		BoundingBox* box = newBoxes->at(i);
+	for(uint32_t i = 0; i < newBoxes->count; i++){
+		glm::vec2 position = layout.positions[i];
+		glm::vec2 size = layout.sizes[i];
 		
-		// check for negative w/h
-		if(box->size.x <= 0 || box->size.y <= 0){
-			// delete box
-			destroyBbox(box);
-			
-			// remove box (kinda)
-			newBoxes->at(i) = NULL;
-			
-			// prevent skipping
-			//i--;
-			continue;
-		}
+		// check for negative w/h (those boxes are dropped)
+		if(size.x <= 0 || size.y <= 0) continue;
+		
+		BoundingBox* box = createBbox(glm::vec3(position.x, original->position.y, position.y), size);
 		
-		//box->splitIndex = i;
+		newBoxes->boxes[i] = box;
+		newBoxes->live |= 1 << i;
 		
 		// correct large sizes
 		box->size.x = std::min(original->size.x, box->size.x);
@@ -692,34 +1709,19 @@ void splitBbox(std::vector<BoundingBox*>* newBoxes, BoundingBox* original, Bound
 		
 		generateBboxCorners(box);
 	}
-	
-	// FIXME: find a better way to do adjacency
-	
-	// adjacency
-	for(uint32_t i = 0; i < newBoxes->size(); i++){
-		BoundingBox* box = newBoxes->at(i);
-		
-		if(!box) continue;
+}
+
+// mark each box a split produced as adjacent to the next one
+// FIXME: find a better way to do adjacency
+void linkSplitBoxes(const SplitResult* split){
+	// the original box has nothing to be linked to
+	if(split->count < 2) return;
+	
+	for(uint32_t i = 0; i < split->count; i++){
+		if(!isSplitBoxLive(*split, i)) continue;
 		
-		BoundingBox* after = newBoxes->at( (i+1) % newBoxes->size() );
+		uint32_t after = (i+1) % split->count;
 		
-		if(after) markAdjacent(box, after);
+		if(isSplitBoxLive(*split, after)) markAdjacent(split->boxes[i], split->boxes[after]);
 	}
-	
-	// remove null boxes
-	/*for(uint32_t i = 0; i < newBoxes->size(); i++){
-		BoundingBox* box = newBoxes->at(i);
-		
-		if(!box){
-			newBoxes->erase(newBoxes->begin() + i);
-			i--;
-		}
-	}*/
-	
-	// done
-	return;
 }
-
-// splits bboxes into an anvil pattern (long on top and bottom, short on sides)
-void splitBboxAnvil(std::vector<BoundingBox*>* newBoxes, BoundingBox* original, BoundingBox* splitter){
-}
\ No newline at end of file
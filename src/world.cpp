@@ -1,38 +1,67 @@
 // world parser
 #include <world.hpp>
 #include <utils.hpp>
+#include <scan.hpp>
+#include <worldcache.hpp>
 
 #include <cctype>
+#include <cstring>
 #include <ctgmath>
 
-// object
-Object* createEmptyObject(){
-	Object* obj = allocateMemoryForType<Object>();
+#include <algorithm>
+#include <thread>
+
+// objects
+uint32_t addObject(ObjectArrays* objects, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, const std::string_view* ids, uint32_t idCount){
+	uint32_t index = objects->positions.size();
 	
-	obj->position = glm::vec3(0);
-	obj->rotation = glm::vec3(0);
-	obj->scale = glm::vec3(0);
+	objects->positions.push_back(position);
+	objects->rotations.push_back(rotation);
+	objects->scales.push_back(scale);
 	
-	obj->bboxes = new std::vector<BoundingBox*>();
-	obj->reachable = false;
+	objects->tops.push_back(position.y + scale.y/2.f);
+	objects->bottoms.push_back(position.y - scale.y/2.f);
 	
-	obj->ids = new std::vector<std::string>();
+	objects->idStarts.push_back(objects->ids.size());
+	objects->idCounts.push_back(idCount);
 	
-	obj->children = 0;
+	for(uint32_t i = 0; i < idCount; i++){
+		objects->ids.push_back( std::make_pair(objects->idPool.length(), ids[i].length()) );
+		objects->idPool += ids[i];
+	}
 	
-	return obj;
+	return index;
 }
 
-Object* createObject(glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, std::vector<std::string>* ids){
-	Object* obj = createEmptyObject();
+// copy an object from another set of objects
+uint32_t appendObject(ObjectArrays* objects, const ObjectArrays* from, uint32_t index){
+	uint32_t object = addObject(objects, from->positions[index], from->rotations[index], from->scales[index], NULL, 0);
+	
+	objects->idCounts[object] = from->idCounts[index];
+	
+	for(uint32_t i = 0; i < from->idCounts[index]; i++){
+		std::string_view id = getObjectId(from, index, i);
+		
+		objects->ids.push_back( std::make_pair(objects->idPool.length(), id.length()) );
+		objects->idPool += id;
+	}
 	
-	obj->position = position;
-	obj->rotation = rotation;
-	obj->scale = scale;
+	return object;
+}
+
+// keeps the top + bottom heights in sync with the object
+void setObjectTransform(ObjectArrays* objects, uint32_t index, glm::vec3 position, glm::vec3 scale){
+	objects->positions[index] = position;
+	objects->scales[index] = scale;
 	
-	obj->ids->assign(ids->begin(), ids->end());
+	objects->tops[index] = position.y + scale.y/2.f;
+	objects->bottoms[index] = position.y - scale.y/2.f;
+}
+
+std::string_view getObjectId(const ObjectArrays* objects, uint32_t object, uint32_t id){
+	const std::pair<uint32_t, uint32_t>& slice = objects->ids[objects->idStarts[object] + id];
 	
-	return obj;
+	return std::string_view(objects->idPool.data() + slice.first, slice.second);
 }
 
 // world
@@ -54,106 +83,185 @@ const char walkBoxBlockDelimiter = '~';
 const char settingsBlockDelimiter = '@';
 const char triggerBlockDelimiter = '!';
 
-// create a block
-Block* createBlock(){
-	Block* block = allocateMemoryForType<Block>();
+// smallest chunk worth giving its own thread when parsing in parallel
+const size_t minimumChunkSize = 1 << 20;
+
+// amount read from a stream at a time
+const size_t streamChunkSize = 1 << 16;
+
+// object in scene->objects whose model (an id in scene->models) is looked up later
+struct UnresolvedModel {
+	uint32_t object;
+	uint32_t model;
+	
+	// amount of vertex data blocks in the same chunk that came before the object, only those definitions apply to it
+	uint32_t definitions;
+};
+
+// vertex data block parsed while models are deferred, model is an id in scene->models
+struct ModelDefinition {
+	uint32_t model;
+	glm::vec3 offset;
+	glm::vec3 size;
+};
+
+// where parsed blocks end up
+struct ParseContext {
+	Scene* scene;
 	
-	// construct members
-	block->ids = new std::vector<std::string>();
-	block->strings = new std::vector<std::string>();
-	block->numbers = new std::vector<float>();
-	block->parameterBuffer = new std::string();
+	// when true, object blocks don't look up their model right away, they're added to unresolvedModels instead (to be resolved once every vertex data block is known)
+	bool deferModels;
 	
-	block->parameterIndex = 0;
+	// objects whose models haven't been looked up yet, and every vertex data block in the order they came in (only filled in when deferModels is true)
+	std::vector<UnresolvedModel> unresolvedModels;
+	std::vector<ModelDefinition> definitions;
 	
-	return block;
+	// last model an object block used, instanced props tend to come in long runs of the same model
+	std::string_view lastModelName;
+	uint32_t lastModel = UINT32_MAX;
+};
+
+// skips a comment starting at data[index], returns the index of the newline ending it (or size)
+static inline size_t skipComment(const char* data, size_t index, size_t size){
+	const char* newline = (const char*)memchr(data + index, '\n', size - index);
+	
+	return newline ? newline - data : size;
 }
 
-// empties out buffers and vectors, but keeps memory allocated
+// empties out vectors, but keeps memory allocated
 void emptyBlock(Block* block){
-	// erase parameter buffer
-	block->parameterBuffer->clear();
-	
 	// empty vectors
-	block->ids->clear();
-	block->strings->clear();
-	block->numbers->clear();
+	block->ids.clear();
+	block->strings.clear();
+	block->numbers.clear();
 	
 	// reset parameter index
 	block->parameterIndex = 0;
 }
 
-// completely deletes occupied memory
-void destroyBlock(Block* block){
-	// destruct members
-	delete block->ids;
-	delete block->strings;
-	delete block->numbers;
-	delete block->parameterBuffer;
+// flush a parameter slice into the block
+void flushParameter(Block* block, std::string_view parameter, bool parsingIds){
+	if(parsingIds){
+		if(parameter.length() > 0) block->ids.push_back(parameter);
+	} else {
+		float f;
+		
+		if(parseNumber(parameter, f)){
+			block->numbers.push_back(f);
+		} else {
+			block->strings.push_back(parameter);
+		}
+	}
 	
-	free(block);
+	// increment parameterIndex
+	block->parameterIndex++;
 }
 
-// block char parser
-bool blockCharParser(Block* block, char byte){
-	// ensure that block exists
-	if(block == NULL){
-		// weird problem, give up
-		return false;
+// trims whitespace off of data[start, end) and extends the current parameter with whatever's left
+static inline void extendParameter(const char* data, size_t start, size_t end, size_t& parameterStart, size_t& parameterEnd, bool& parameterEmpty){
+	while(start < end && isspace(data[start])) start++;
+	while(end > start && isspace(data[end-1])) end--;
+	
+	if(start == end) return;
+	
+	if(parameterEmpty){
+		parameterStart = start;
+		parameterEmpty = false;
 	}
 	
-	// add byte to parameter buffer if it's not equal to the parameter delimiter or the close block
-	if(byte != blockOpen && byte != parameterDelimiter && byte != blockClose && byte != idsOpen && byte != idsClose){
-		block->parameterBuffer->push_back(byte);
-	} else if(byte != blockOpen && byte != idsOpen){
-		// flush parameter buffer
-		if(byte != idsClose){
-			if(block->parameterBuffer->length() > 0 && isStringNumber( *block->parameterBuffer )){
-				float f = std::stof(*block->parameterBuffer);
-				
-				block->numbers->push_back( f );
-			} else {
-				block->strings->push_back( *block->parameterBuffer );
-			}
-		}
+	parameterEnd = end;
+}
+
+// block tokenizer
+// reads a block starting at index (right after the block delimiter) and hands out slices of the buffer for each parameter, without copying anything
+// the cursor is used to jump between structural bytes, and is left positioned after the block
+// returns the index right after the block close, or the buffer size if the block was never closed (closed is set accordingly)
+size_t tokenizeBlock(Block* block, ScanCursor& cursor, size_t index, bool& closed){
+	const char* data = cursor.data;
+	size_t size = cursor.size;
+	
+	// start and end of the current parameter (whitespace around parameters is trimmed off, whitespace inside of them is kept)
+	size_t parameterStart = index;
+	size_t parameterEnd = index;
+	bool parameterEmpty = true;
+	
+	// true while between idsOpen and idsClose
+	bool parsingIds = false;
+	
+	closed = false;
+	
+	// a comment could start the block if the delimiter was the last byte on its line
+	if(index < size && data[index] == commentDelimiter && (index == 0 || data[index-1] == '\n')){
+		index = skipComment(data, index, size);
+		scanSeek(cursor, index);
+	}
+	
+	while(index < size){
+		// jump to the next structural byte
+		size_t next = scanNext(cursor);
+		char byte = next < size ? data[next] : 0;
 		
-		// if parameterIndex is at the maximum value, return true (done)
-		if(byte == blockClose){
-			// block is done parsing
-			return true;
-		}
-		// if ids opener is found, parse ids instead
-		else if(byte == idsClose && block->parameterBuffer->length() > 0){
-			block->ids->push_back( *block->parameterBuffer );
-		}
+		// block delimiters mean nothing inside of a block, they're just part of a parameter
+		if(byte != '\n' && byte != parameterDelimiter && byte != blockOpen && byte != blockClose && byte != idsOpen && byte != idsClose && next < size) continue;
 		
-		// reset parameterBuffer
-		block->parameterBuffer->clear();
+		// anything in between is part of a parameter
+		extendParameter(data, index, next, parameterStart, parameterEnd, parameterEmpty);
 		
-		// otherwise, increment parameterIndex
-		block->parameterIndex++;
+		if(next >= size) break;
+		
+		index = next+1;
+		
+		if(byte == '\n'){
+			// check for hashtag at the start of the next line (comment, ignores the rest of the line)
+			if(index < size && data[index] == commentDelimiter){
+				index = skipComment(data, index, size);
+				scanSeek(cursor, index);
+			}
+		} else if(byte == parameterDelimiter || byte == blockClose || byte == idsClose){
+			std::string_view parameter = parameterEmpty ? std::string_view() : std::string_view(data + parameterStart, parameterEnd - parameterStart);
+			
+			// an empty parameter in front of idsClose is just the trailing delimiter of the id list
+			if(byte != idsClose || !parameterEmpty) flushParameter(block, parameter, parsingIds);
+			
+			parameterEmpty = true;
+			
+			if(byte == idsClose){
+				parsingIds = false;
+			} else if(byte == blockClose){
+				// block is done parsing
+				closed = true;
+				return index;
+			}
+		} else {
+			// block or ids opener, anything before an opener isn't a parameter
+			parameterEmpty = true;
+			
+			if(byte == idsOpen) parsingIds = true;
+		}
 	}
 	
-	return false;
+	return size;
 }
 
-void objectBlockToScene(Block* block, Scene* scene){
+void objectBlockToScene(Block* block, ParseContext* context){
+	Scene* scene = context->scene;
+	
 	// validate float values
 	uint32_t numNums = 9; // I like this variable name
-	if(block->numbers->size() != numNums){
-		printf("Invalid amount of parameters in an object block (%d numbers present, exactly %d required)\n", block->numbers->size(), numNums);
+	if(block->numbers.size() != numNums){
+		printf("Invalid amount of parameters in an object block (%d numbers present, exactly %d required)\n", block->numbers.size(), numNums);
 		return;
 	}
 	
 	// check for keywords
-	uint32_t stringParams = block->strings->size();
+	uint32_t stringParams = block->strings.size();
 	
 	if(stringParams > 1){
 		// loop breaks when there are no more keyword
 		bool keywordsLeft = true;
 		
 		while(keywordsLeft){
-			std::string keyword = block->strings->at(stringParams-1);
+			std::string_view keyword = block->strings.at(stringParams-1);
 			
 			if(keyword == "nowalk"){
 				// ignore this object completely
@@ -168,28 +276,79 @@ void objectBlockToScene(Block* block, Scene* scene){
 		}
 	}
 	
-	// create new object
-	Object* object = createEmptyObject();
+	// load some float values
+	glm::vec3 position = glm::vec3(block->numbers[0], block->numbers[1], block->numbers[2]);
+	glm::vec3 rotation = glm::vec3(block->numbers[3], block->numbers[4], block->numbers[5]);
+	glm::vec3 scale = glm::vec3(block->numbers[6], block->numbers[7], block->numbers[8]);
+	
+	std::string_view modelName = block->strings.at(stringParams-1);
 	
-	object->ids->assign(block->ids->begin(), block->ids->end());
+	if(context->lastModel == UINT32_MAX || modelName != context->lastModelName){
+		context->lastModel = internModel(scene->models, modelName);
+		
+		// the interned copy, modelName goes away with the buffer (streams reuse theirs)
+		context->lastModelName = scene->models->names[context->lastModel];
+	}
 	
-	// load some float values
-	for(uint32_t i = 0; i < block->numbers->size(); i++){
-		(&object->position.x)[i] = block->numbers->at(i);
+	uint32_t model = context->lastModel;
+	
+	// leave the model for later if all vertex data isn't known yet
+	if(context->deferModels){
+		context->unresolvedModels.push_back({(uint32_t)scene->objects->positions.size(), model, (uint32_t)context->definitions.size()});
+	} else if(!resolveObjectModel(position, rotation, scale, model, scene->models)){
+		return;
 	}
 	
-	// load model size + offset and apply corrections
-	std::string model = block->strings->at(stringParams-1);
+	// push to objects
+	addObject(scene->objects, position, rotation, scale, block->ids.data(), block->ids.size());
+}
+
+// models
+uint32_t internModel(ModelTable* models, std::string_view name){
+	auto id = models->ids.find(name);
+	
+	if(id != models->ids.end()) return id->second;
 	
-	glm::vec3 size = object->scale;
-	glm::vec3 modelOffset = scene->modelSizes->at(model).first; // FIXME: catch potential exception
-	glm::vec3 modelBounding = scene->modelSizes->at(model).second;
+	uint32_t model = models->names.size();
 	
-	object->scale = size * modelBounding;
+	models->names.push_back(std::string(name));
+	models->ids[models->names.back()] = model;
+	
+	models->offsets.push_back(glm::vec3(0));
+	models->sizes.push_back(glm::vec3(0));
+	models->defined.push_back(false);
+	
+	return model;
+}
+
+// later definitions replace earlier ones
+void defineModel(ModelTable* models, std::string_view name, glm::vec3 offset, glm::vec3 size){
+	uint32_t model = internModel(models, name);
+	
+	models->offsets[model] = offset;
+	models->sizes[model] = size;
+	models->defined[model] = true;
+}
+
+// apply a model's size + offset to an object's position and scale, returns false if the model was never defined
+bool resolveObjectModel(glm::vec3& position, glm::vec3 rotation, glm::vec3& scale, uint32_t model, const ModelTable* models){
+	if(!models->defined[model]){
+		const std::string& name = models->names[model];
+		
+		printf("Unknown model \"%.*s\" in an object block (object ignored)\n", (int)name.length(), name.data());
+		return false;
+	}
+	
+	// apply model corrections
+	glm::vec3 size = scale;
+	glm::vec3 modelOffset = models->offsets[model];
+	glm::vec3 modelBounding = models->sizes[model];
+	
+	scale = size * modelBounding;
 	
 	// snap rotation to nearest axis and then account for rotation in scale
 	for(uint32_t i = 0; i < 3; i++){
-		float rot = object->rotation[i];
+		float rot = rotation[i];
 		
 		// snap to closest axis
 		rot = fmod(rot, 180.f);
@@ -203,11 +362,11 @@ void objectBlockToScene(Block* block, Scene* scene){
 			uint32_t i1 = ((i-1)+3)%3;
 			uint32_t i2 = (i+1)%3;
 			
-			float s1 = object->scale[i1];
-			float s2 = object->scale[i2];
+			float s1 = scale[i1];
+			float s2 = scale[i2];
 			
-			object->scale[i1] = s2;
-			object->scale[i2] = s1;
+			scale[i1] = s2;
+			scale[i2] = s1;
 			
 			// also swap offset axes
 			s1 = modelOffset[i1];
@@ -218,20 +377,21 @@ void objectBlockToScene(Block* block, Scene* scene){
 		}
 	}
 	
-	object->position += size * modelOffset; // apply scaling to offset as well
+	position += size * modelOffset; // apply scaling to offset as well
 	
-	// push to objects
-	scene->objects->push_back(object);
+	return true;
 }
 
-void vertexDataBlockToScene(Block* block, Scene* scene){
+void vertexDataBlockToScene(Block* block, ParseContext* context){
+	Scene* scene = context->scene;
+	
 	// load values
-	std::string vertexDataName = block->strings->at(1);
+	std::string_view vertexDataName = block->strings.at(1);
 	
 	glm::vec3 boundingOffset = glm::vec3(0);
 	
 	for(uint32_t i = 0; i < 3; i++){
-		float v = i < block->numbers->size() ? block->numbers->at(i) : 0.0f;
+		float v = i < block->numbers.size() ? block->numbers.at(i) : 0.0f;
 		
 		// I'd like to use simple bracket notation here (boundingSize[i] = v) but glm fails if I do(?)
 		// I'm guessing that bracket notation is not meant for assignment, but I don't feel like digging through its documentation to find out
@@ -241,155 +401,513 @@ void vertexDataBlockToScene(Block* block, Scene* scene){
 	glm::vec3 boundingSize = glm::vec3(0);
 	
 	for(uint32_t i = 3; i < 6; i++){
-		float v = i < block->numbers->size() ? block->numbers->at(i) : 0.0f;
+		float v = i < block->numbers.size() ? block->numbers.at(i) : 0.0f;
 		
 		(&boundingSize.x)[i-3] = v;
 	}
 	
-	(*scene->modelSizes)[vertexDataName] = std::make_pair(boundingOffset, boundingSize);
+	defineModel(scene->models, vertexDataName, boundingOffset, boundingSize);
+	
+	// objects are resolved against whatever definition came before them, so the order has to be kept
+	if(context->deferModels) context->definitions.push_back({internModel(scene->models, vertexDataName), boundingOffset, boundingSize});
 }
 
-void walkBoxBlockToScene(Block* block, Scene* scene){
+void walkBoxBlockToScene(Block* block, ParseContext* context){
+	Scene* scene = context->scene;
+	
 	// load values
-	float x = block->numbers->at(0);
-	float y = block->numbers->at(1);
-	float z	= block->numbers->at(2);
+	float x = block->numbers.at(0);
+	float y = block->numbers.at(1);
+	float z	= block->numbers.at(2);
 	
-	float w = block->numbers->at(3);
-	float d = block->numbers->at(4);
+	float w = block->numbers.at(3);
+	float d = block->numbers.at(4);
 	
 	glm::vec3 position = glm::vec3(x, y, z);
 	glm::vec2 size = glm::vec2(w, d);
 	
 	// create bounding box
 	// NOTE: in the original it creates a bounding box, but in this we treat it like an object because I'm lazy
-	Object* box = createObject(position, glm::vec3(0), glm::vec3(size.x, 0, size.y), new std::vector<std::string>());
-	
 	// add to scene
-	scene->objects->push_back(box);
+	addObject(scene->objects, position, glm::vec3(0), glm::vec3(size.x, 0, size.y), NULL, 0);
 }
 
-Scene* createScene(){
+// scene without any models, chunks of a world are parsed into these
+Scene* createEmptyScene(){
 	Scene* scene = allocateMemoryForType<Scene>();
 	
-	scene->objects = new std::vector<Object*>();
-	scene->modelSizes = new std::map<std::string, std::pair<glm::vec3, glm::vec3>>();
+	scene->objects = new ObjectArrays();
+	scene->models = new ModelTable();
+	
+	scene->stats = ParseStats();
+	
+	return scene;
+}
+
+void destroyScene(Scene* scene){
+	delete scene->objects;
+	delete scene->models;
+	
+	free(scene);
+}
+
+Scene* createScene(){
+	Scene* scene = createEmptyScene();
 	
 	// fixes javascript compatibility issue
-	(*scene->modelSizes)["cube"] = std::make_pair(glm::vec3(0, 0, 0), glm::vec3(1, 1, 1));
+	defineModel(scene->models, "cube", glm::vec3(0, 0, 0), glm::vec3(1, 1, 1));
 	
 	return scene;
 }
 
 // parse world (create new scene)
-Scene* parseWorld(const char* file){
+Scene* parseWorld(const char* file, uint32_t threads, bool cache){
 	Scene* scene = createScene();
 	
-	if(!parseWorldIntoScene(scene, file)){
+	if(!parseWorldIntoScene(scene, file, threads, cache)){
 		return NULL;
 	}
 	
 	return scene;
 }
 
+// structural bytes of a .world file, everything else is either part of a parameter or ignored
+// comments don't need to be in here, they're found through the newline in front of them
+static const ScanSet structuralScanSet = createScanSet(",[]{}\n$*+~");
+
+// delimiters of the blocks the walkmap needs, and the parsers for them
+static const char blockDelimiters[] = {objectBlockDelimiter, vertexDataBlockDelimiter, modelBlockDelimiter, walkBoxBlockDelimiter};
+static void (*const blockParsers[])(Block*,ParseContext*) = {objectBlockToScene, vertexDataBlockToScene, vertexDataBlockToScene, walkBoxBlockToScene};
+
+// returns the index of the block parser for a delimiter, or -1 if the block is ignored
+static inline int32_t findBlockParser(char byte){
+	for(int32_t i = 0; i < sizeof(blockDelimiters)/sizeof(char); i++){
+		if(byte == blockDelimiters[i]) return i;
+	}
+	
+	return -1;
+}
+
+// skip the rest of a block the walkmap doesn't need (textures, lights, audio, triggers, settings), index is right after its ids open or block open
+// these blocks can be huge, so this goes straight to the block close with memchr instead of looking at anything inside (including comments)
+// if closed isn't NULL, a block that isn't closed before size isn't counted (the rest of it hasn't been read yet)
+static inline size_t skipIgnoredBlock(const char* data, size_t index, size_t size, ParseStats* stats, bool* closed = NULL){
+	const char* open = NULL;
+	
+	// ids come before the block open, they get skipped over to the block open and then the block itself
+	if(data[index-1] == idsOpen){
+		open = (const char*)memchr(data + index, blockOpen, size - index);
+		
+		if(open == NULL){
+			if(closed) *closed = false;
+			return size;
+		}
+	}
+	
+	const char* close = (const char*)memchr(open ? open + 1 : data + index, blockClose, size - (open ? open - data + 1 : index));
+	size_t end = close ? close - data + 1 : size;
+	
+	if(closed){
+		*closed = close != NULL;
+		
+		if(!*closed) return size;
+	}
+	
+	if(open){
+		if(stats) stats->bytesSkipped += open - (data + index);
+		
+		index = open - data + 1;
+	}
+	
+	if(stats){
+		stats->blocksSkipped++;
+		stats->bytesSkipped += end - index;
+	}
+	
+	return end;
+}
+
 // parse world into an existing scene object
-bool parseWorldIntoScene(Scene* scene, const char* file){
-	// file buffer
-	char* fileBuffer = read_entire_file(file);
+bool parseWorldIntoScene(Scene* scene, const char* file, uint32_t threads, bool cache){
+	// "-" is stdin, which is streamed instead of read all at once
+	if(strcmp(file, "-") == 0) return parseWorldStream(scene, stdin);
+	
+	// file buffer (mapped straight from the file when possible)
+	FileBuffer* fileBuffer = mapEntireFile(file);
 	
 	if(fileBuffer == NULL){
 		printf("Invalid path for world %s\n", file);
 		return false;
 	}
 	
-	// settings
-	char blockDelimiters[] = {objectBlockDelimiter, vertexDataBlockDelimiter, modelBlockDelimiter, walkBoxBlockDelimiter};
+	// only regular files get a cache, there's nowhere to put one for a pipe
+	cache = cache && fileBuffer->mapped;
+	
+	uint64_t sourceHash = 0;
+	std::string cachePath;
+	
+	if(cache){
+		sourceHash = hashBuffer(fileBuffer->data, fileBuffer->size);
+		cachePath = getSceneCachePath(file);
+		
+		// unchanged since the cache was compiled, skip parsing entirely
+		if(loadSceneCache(scene, cachePath.c_str(), sourceHash, fileBuffer->size)){
+			scene->stats.fromCache = true;
+			
+			unmapEntireFile(fileBuffer);
+			
+			return true;
+		}
+	}
+	
+	uint32_t firstObject = scene->objects->positions.size();
+	
+	parseWorldBuffer(scene, fileBuffer->data, fileBuffer->size, threads);
+	
+	// failing to write a cache isn't fatal, the next run just parses again
+	if(cache && !writeSceneCache(scene, firstObject, cachePath.c_str(), sourceHash, fileBuffer->size)){
+		printf("Couldn't write scene cache %s\n", cachePath.c_str());
+	}
+	
+	unmapEntireFile(fileBuffer);
+	
+	return true;
+}
+
+// parse the blocks in data[begin, end) (begin has to be outside of any block)
+// if resume isn't NULL, the range is only the start of the input: parsing stops at the first block or comment that isn't finished before end, and resume is set to where parsing should continue once more input is appended (end if everything was parsed)
+static void parseWorldRange(ParseContext* context, const char* data, size_t begin, size_t end, size_t* resume = NULL){
+	if(resume) *resume = end;
 	
 	// control states
-	bool parsingBlock = false;
-	bool ignoringUntilNextLine = false;
-	int32_t blockParsing = -1;
-	Block* blockBuffer = createBlock();
-	
-	// pointers to char parsers
-	// first param = pointer to block (void* here to be valid for all pointers)
-	// second param = char to parse
-	// returns false if the block hasn't finished parsing and true if it has
-	void (*blockParsers[4])(Block*,Scene*) {objectBlockToScene, vertexDataBlockToScene, vertexDataBlockToScene, walkBoxBlockToScene};
-	
-	// loop through each byte
-	char byte;
-	char lastByte;
-	uint32_t byteIndex = 0;
-	
-	do {
-		// load byte
-		byte = fileBuffer[byteIndex];
-		if(byteIndex > 0) lastByte = fileBuffer[byteIndex-1];
-		
-		uint32_t index = byteIndex;
-		byteIndex++;
-		
-		// if currently in a comment, check for newline
-		if(ignoringUntilNextLine){
-			// check for newline
-			if(byte == '\n'){
-				ignoringUntilNextLine = false;
+	Block blockBuffer;
+	emptyBlock(&blockBuffer);
+	
+	size_t byteIndex = begin;
+	
+	// check for hashtag at the start of the range (comment, ignores)
+	if(begin < end && data[begin] == commentDelimiter && (begin == 0 || data[begin-1] == '\n')){
+		byteIndex = skipComment(data, begin, end);
+		
+		if(resume && byteIndex >= end){
+			*resume = begin;
+			return;
+		}
+	}
+	
+	ScanCursor cursor = createScanCursor(data, end, &structuralScanSet);
+	scanSeek(cursor, byteIndex);
+	
+	// jump from structural byte to structural byte (everything else outside of a block is ignored)
+	while( byteIndex < end ){
+		size_t index = scanNext(cursor);
+		
+		if(index >= end) break;
+		
+		char byte = data[index];
+		byteIndex = index+1;
+		
+		// check for hashtag at the start of the next line (comment, ignores)
+		if(byte == '\n'){
+			// the next line (and whether it's a comment) hasn't been read yet, resume from the newline
+			if(resume && byteIndex >= end){
+				*resume = index;
+				return;
+			}
+			
+			if(byteIndex < end && data[byteIndex] == commentDelimiter){
+				byteIndex = skipComment(data, byteIndex, end);
+				
+				if(resume && byteIndex >= end){
+					*resume = index;
+					return;
+				}
+				
+				scanSeek(cursor, byteIndex);
 			}
 			
 			continue;
 		}
 		
-		// check for whitespace (ignored)
-		if(isspace(byte)) continue;
-		
-		// check for hashtag (comment, ignores)
-		if( (lastByte == '\n' || index == 0) && byte == commentDelimiter){
-			ignoringUntilNextLine = true;
+		// an ids open or block open out here belongs to a block the walkmap doesn't need (walkmap blocks are opened inside tokenizeBlock)
+		if(byte == blockOpen || byte == idsOpen){
+			bool closed = true;
+			
+			byteIndex = skipIgnoredBlock(data, byteIndex, end, &context->scene->stats, resume ? &closed : NULL);
+			
+			if(!closed){
+				*resume = index;
+				return;
+			}
+			
+			scanSeek(cursor, byteIndex);
+			
 			continue;
 		}
 		
-		// byte parser
+		// look for delimiter
+		int32_t blockParsing = findBlockParser(byte);
 		
-		// if a block isn't being parsed currently, look for a delimiter
-		if(blockParsing < 0){
-			// look for delimiter
-			for(int32_t i = 0; i < sizeof(blockDelimiters)/sizeof(char); i++){
-				if(byte == blockDelimiters[i]){
-					blockParsing = i;
-					
-					// skip block open
-					/*while(byte != blockOpen && byte != 0){
-						byte = fileBuffer[byteIndex];
-						
-						byteIndex++;
-					}*/
-					
-					//break;
-				}
+		if(blockParsing < 0) continue;
+		
+		// tokenize the rest of the block straight out of the buffer
+		bool done;
+		byteIndex = tokenizeBlock(&blockBuffer, cursor, byteIndex, done);
+		
+		// the rest of the block hasn't been read yet, it's tokenized again from the delimiter once it has
+		if(resume && !done){
+			*resume = index;
+			return;
+		}
+		
+		if(done){
+			// parse block into scene
+			(*blockParsers[blockParsing])(&blockBuffer, context);
+			
+			context->scene->stats.blocksParsed++;
+		}
+		
+		// empty the block
+		emptyBlock(&blockBuffer);
+	} // end at the end of the range (mapped files have no null terminator)
+}
+
+// skip over a block starting at index (right after the delimiter) without tokenizing it, returns the index right after the block close
+static size_t skipBlock(ScanCursor& cursor, size_t index){
+	const char* data = cursor.data;
+	size_t size = cursor.size;
+	
+	if(index < size && data[index] == commentDelimiter && data[index-1] == '\n'){
+		index = skipComment(data, index, size);
+		scanSeek(cursor, index);
+	}
+	
+	while(true){
+		size_t next = scanNext(cursor);
+		
+		if(next >= size) return size;
+		
+		if(data[next] == blockClose) return next+1;
+		
+		if(data[next] == '\n' && next+1 < size && data[next+1] == commentDelimiter){
+			scanSeek(cursor, skipComment(data, next+1, size));
+		}
+	}
+}
+
+// find the offsets to split a world buffer at so that each chunk is about the same size and only contains whole blocks
+// returns chunks+1 offsets (the first is always 0 and the last is always size), fewer if there aren't enough blocks
+static std::vector<size_t> findChunkSplits(const char* data, size_t size, uint32_t chunks){
+	std::vector<size_t> splits = {0};
+	
+	ScanCursor cursor = createScanCursor(data, size, &structuralScanSet);
+	
+	size_t byteIndex = 0;
+	
+	if(size > 0 && data[0] == commentDelimiter){
+		byteIndex = skipComment(data, 0, size);
+		scanSeek(cursor, byteIndex);
+	}
+	
+	// same walk as parseWorldRange, but every block is skipped instead of tokenized
+	while(byteIndex < size && splits.size() < chunks){
+		size_t index = scanNext(cursor);
+		
+		if(index >= size) break;
+		
+		char byte = data[index];
+		byteIndex = index+1;
+		
+		if(byte == '\n'){
+			if(byteIndex < size && data[byteIndex] == commentDelimiter){
+				byteIndex = skipComment(data, byteIndex, size);
+				scanSeek(cursor, byteIndex);
 			}
 			
 			continue;
 		}
 		
-		// if a block is being parsed, pass the byte to the block parser function
-		bool done = (*blockCharParser)(blockBuffer, byte);
+		if(byte == blockOpen || byte == idsOpen){
+			byteIndex = skipIgnoredBlock(data, byteIndex, size, NULL);
+			scanSeek(cursor, byteIndex);
+		} else if(findBlockParser(byte) >= 0){
+			byteIndex = skipBlock(cursor, byteIndex);
+		} else {
+			continue;
+		}
 		
-		if(done){
-			// parse block into scene
-			(*blockParsers[blockParsing])(blockBuffer, scene);
+		// split after this block once the chunk is big enough
+		if(byteIndex < size && byteIndex >= size / chunks * splits.size()) splits.push_back(byteIndex);
+	}
+	
+	splits.push_back(size);
+	
+	return splits;
+}
+
+// parse a buffer containing a world into an existing scene object
+void parseWorldBuffer(Scene* scene, const char* data, size_t size, uint32_t threads){
+	if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	
+	// not worth spinning up threads for small worlds
+	if(size < threads * minimumChunkSize) threads = std::max((size_t)1, size / minimumChunkSize);
+	
+	if(threads <= 1){
+		ParseContext context;
+		context.scene = scene;
+		context.deferModels = false;
+		
+		parseWorldRange(&context, data, 0, size);
+		
+		return;
+	}
+	
+	// make sure the scan kernel is picked before any threads use it
+	getScanKernel();
+	
+	std::vector<size_t> splits = findChunkSplits(data, size, threads);
+	uint32_t chunks = splits.size()-1;
+	
+	// each chunk is parsed into its own scene, models are resolved once every chunk is done (objects can reference vertex data from any chunk)
+	std::vector<ParseContext> contexts(chunks);
+	std::vector<std::thread> workers;
+	
+	for(uint32_t i = 0; i < chunks; i++){
+		contexts[i].scene = createEmptyScene();
+		contexts[i].deferModels = true;
+		
+		workers.push_back( std::thread(parseWorldRange, &contexts[i], data, splits[i], splits[i+1], (size_t*)NULL) );
+	}
+	
+	for(uint32_t i = 0; i < chunks; i++){
+		workers[i].join();
+	}
+	
+	workers.clear();
+	
+	// map each chunk's model ids to the merged table's (one lookup per distinct name, not per object)
+	std::vector<std::vector<uint32_t>> modelRemaps(chunks);
+	
+	for(uint32_t i = 0; i < chunks; i++){
+		ModelTable* models = contexts[i].scene->models;
+		
+		for(uint32_t model = 0; model < models->names.size(); model++){
+			modelRemaps[i].push_back( internModel(scene->models, models->names[model]) );
+		}
+	}
+	
+	// an object uses the last definition of its model before it in the file, which is either in its own chunk or whatever the chunks before it left behind
+	// so each chunk's table starts out as the merged table of every chunk before it, and chunks are merged in file order (later definitions replace earlier ones, same as parsing sequentially)
+	for(uint32_t i = 0; i < chunks; i++){
+		ModelTable* models = contexts[i].scene->models;
+		
+		for(uint32_t model = 0; model < models->names.size(); model++){
+			uint32_t merged = modelRemaps[i][model];
 			
-			// reset block parsing (blockBuffer is freed by block parser when done)
-			blockParsing = -1;
+			models->offsets[model] = scene->models->offsets[merged];
+			models->sizes[model] = scene->models->sizes[merged];
+			models->defined[model] = scene->models->defined[merged];
+		}
+		
+		for(const ModelDefinition& definition : contexts[i].definitions){
+			uint32_t merged = modelRemaps[i][definition.model];
 			
-			// empty the block
-			emptyBlock(blockBuffer);
+			scene->models->offsets[merged] = definition.offset;
+			scene->models->sizes[merged] = definition.size;
+			scene->models->defined[merged] = true;
 		}
-	} while( byte != 0 ); // end at null terminator
+	}
+	
+	// resolve models in parallel, objects with unknown models are dropped when merging
+	std::vector<std::vector<bool>> dropped(chunks);
 	
-	free(fileBuffer);
+	for(uint32_t i = 0; i < chunks; i++){
+		dropped[i].resize(contexts[i].scene->objects->positions.size(), false);
+		
+		workers.push_back( std::thread([](ParseContext* context, std::vector<bool>* dropped){
+			ObjectArrays* objects = context->scene->objects;
+			ModelTable* models = context->scene->models;
+			
+			// definitions from this chunk are applied as objects pass them
+			uint32_t applied = 0;
+			
+			for(const UnresolvedModel& unresolved : context->unresolvedModels){
+				for(; applied < unresolved.definitions; applied++){
+					const ModelDefinition& definition = context->definitions[applied];
+					
+					models->offsets[definition.model] = definition.offset;
+					models->sizes[definition.model] = definition.size;
+					models->defined[definition.model] = true;
+				}
+				
+				uint32_t object = unresolved.object;
+				
+				glm::vec3 position = objects->positions[object];
+				glm::vec3 scale = objects->scales[object];
+				
+				if(resolveObjectModel(position, objects->rotations[object], scale, unresolved.model, models)){
+					setObjectTransform(objects, object, position, scale);
+				} else {
+					dropped->at(object) = true;
+				}
+			}
+		}, &contexts[i], &dropped[i]) );
+	}
 	
-	destroyBlock(blockBuffer);
+	for(uint32_t i = 0; i < chunks; i++){
+		workers[i].join();
+	}
 	
-	return true;
+	// merge objects + stats in file order
+	for(uint32_t i = 0; i < chunks; i++){
+		scene->stats.blocksParsed += contexts[i].scene->stats.blocksParsed;
+		scene->stats.blocksSkipped += contexts[i].scene->stats.blocksSkipped;
+		scene->stats.bytesSkipped += contexts[i].scene->stats.bytesSkipped;
+		
+		ObjectArrays* objects = contexts[i].scene->objects;
+		
+		for(uint32_t object = 0; object < objects->positions.size(); object++){
+			if(!dropped[i][object]) appendObject(scene->objects, objects, object);
+		}
+		
+		destroyScene(contexts[i].scene);
+	}
+}
+
+// parse a world from a stream (stdin or a pipe) without reading all of it into memory first
+// the stream is read in fixed size chunks, anything after the last finished block in a chunk is carried over to the next one
+bool parseWorldStream(Scene* scene, FILE* stream){
+	ParseContext context;
+	context.scene = scene;
+	context.deferModels = false;
+	
+	// only needs to be bigger than a chunk if a single block is
+	std::vector<char> buffer(streamChunkSize);
+	size_t carried = 0;
+	
+	while(true){
+		if(buffer.size() < carried + streamChunkSize) buffer.resize(carried + streamChunkSize);
+		
+		size_t bytesRead = fread(buffer.data() + carried, sizeof(char), streamChunkSize, stream);
+		size_t size = carried + bytesRead;
+		
+		if(bytesRead == 0){
+			if(ferror(stream)){
+				printf("Error reading world from stream\n");
+				return false;
+			}
+			
+			// end of the stream, whatever was carried over is parsed as is (an unclosed block at the end of a file)
+			parseWorldRange(&context, buffer.data(), 0, size);
+			
+			return true;
+		}
+		
+		size_t resume;
+		parseWorldRange(&context, buffer.data(), 0, size, &resume);
+		
+		// move the unfinished part to the start of the buffer
+		carried = size - resume;
+		memmove(buffer.data(), buffer.data() + resume, carried);
+	}
 }
\ No newline at end of file
@@ -0,0 +1,207 @@
+// compiled scene cache
+#include <worldcache.hpp>
+#include <utils.hpp>
+
+#include <cstdio>
+#include <cstring>
+
+#include <vector>
+
+static const char sceneCacheMagic[4] = {'W', 'M', 'S', 'C'};
+
+std::string getSceneCachePath(const char* file){
+	return std::string(file) + "c";
+}
+
+bool loadSceneCache(Scene* scene, const char* path, uint64_t sourceHash, uint64_t sourceSize){
+	// check if there's a cache at all before trying to map it (a missing cache isn't an error)
+	FILE* exists = fopen(path, "rb");
+	
+	if(exists == NULL) return false;
+	
+	fclose(exists);
+	
+	FileBuffer* cache = mapEntireFile(path);
+	
+	if(cache == NULL) return false;
+	
+	const char* data = cache->data;
+	size_t size = cache->size;
+	
+	SceneCacheHeader header;
+	
+	if(size < sizeof(header)){
+		unmapEntireFile(cache);
+		return false;
+	}
+	
+	memcpy(&header, data, sizeof(header));
+	
+	// stale or from another version
+	if(memcmp(header.magic, sceneCacheMagic, sizeof(sceneCacheMagic)) != 0 || header.version != SCENE_CACHE_VERSION || header.sourceHash != sourceHash || header.sourceSize != sourceSize){
+		unmapEntireFile(cache);
+		return false;
+	}
+	
+	// make sure everything the header claims is actually there
+	size_t modelsOffset = sizeof(SceneCacheHeader);
+	size_t objectsOffset = modelsOffset + (size_t)header.modelCount * sizeof(SceneCacheModel);
+	size_t idsOffset = objectsOffset + (size_t)header.objectCount * sizeof(SceneCacheObject);
+	size_t stringsOffset = idsOffset + (size_t)header.idCount * sizeof(SceneCacheString);
+	
+	if(stringsOffset + header.stringBytes != size){
+		unmapEntireFile(cache);
+		return false;
+	}
+	
+	const SceneCacheModel* models = (const SceneCacheModel*)(data + modelsOffset);
+	const SceneCacheObject* objects = (const SceneCacheObject*)(data + objectsOffset);
+	const SceneCacheString* ids = (const SceneCacheString*)(data + idsOffset);
+	const char* strings = data + stringsOffset;
+	
+	// validate string + id ranges before touching the scene
+	bool valid = true;
+	
+	for(uint32_t i = 0; i < header.modelCount; i++){
+		valid = valid && (size_t)models[i].name.offset + models[i].name.length <= header.stringBytes;
+	}
+	
+	for(uint32_t i = 0; i < header.idCount; i++){
+		valid = valid && (size_t)ids[i].offset + ids[i].length <= header.stringBytes;
+	}
+	
+	for(uint32_t i = 0; i < header.objectCount; i++){
+		valid = valid && (size_t)objects[i].idStart + objects[i].idCount <= header.idCount;
+	}
+	
+	if(!valid){
+		unmapEntireFile(cache);
+		return false;
+	}
+	
+	// models
+	for(uint32_t i = 0; i < header.modelCount; i++){
+		const SceneCacheModel& model = models[i];
+		
+		std::string_view name(strings + model.name.offset, model.name.length);
+		
+		defineModel(scene->models, name, glm::vec3(model.offset[0], model.offset[1], model.offset[2]), glm::vec3(model.size[0], model.size[1], model.size[2]));
+	}
+	
+	// objects
+	std::vector<std::string_view> objectIds;
+	
+	for(uint32_t i = 0; i < header.objectCount; i++){
+		const SceneCacheObject& cached = objects[i];
+		
+		objectIds.clear();
+		
+		for(uint32_t j = 0; j < cached.idCount; j++){
+			const SceneCacheString& id = ids[cached.idStart + j];
+			
+			objectIds.push_back( std::string_view(strings + id.offset, id.length) );
+		}
+		
+		glm::vec3 position = glm::vec3(cached.position[0], cached.position[1], cached.position[2]);
+		glm::vec3 rotation = glm::vec3(cached.rotation[0], cached.rotation[1], cached.rotation[2]);
+		glm::vec3 scale = glm::vec3(cached.scale[0], cached.scale[1], cached.scale[2]);
+		
+		addObject(scene->objects, position, rotation, scale, objectIds.data(), objectIds.size());
+	}
+	
+	unmapEntireFile(cache);
+	
+	return true;
+}
+
+// append a string to the string table
+static SceneCacheString pushCacheString(std::string& strings, std::string_view str){
+	SceneCacheString cached;
+	
+	cached.offset = strings.length();
+	cached.length = str.length();
+	
+	strings += str;
+	
+	return cached;
+}
+
+bool writeSceneCache(Scene* scene, uint32_t firstObject, const char* path, uint64_t sourceHash, uint64_t sourceSize){
+	std::vector<SceneCacheModel> models;
+	std::vector<SceneCacheObject> objects;
+	std::vector<SceneCacheString> ids;
+	std::string strings;
+	
+	ModelTable* modelTable = scene->models;
+	
+	for(uint32_t i = 0; i < modelTable->names.size(); i++){
+		// names objects used without any vertex data behind them
+		if(!modelTable->defined[i]) continue;
+		
+		SceneCacheModel model;
+		
+		for(uint32_t j = 0; j < 3; j++){
+			model.offset[j] = modelTable->offsets[i][j];
+			model.size[j] = modelTable->sizes[i][j];
+		}
+		
+		model.name = pushCacheString(strings, modelTable->names[i]);
+		
+		models.push_back(model);
+	}
+	
+	ObjectArrays* sceneObjects = scene->objects;
+	
+	for(uint32_t i = firstObject; i < sceneObjects->positions.size(); i++){
+		SceneCacheObject cached;
+		
+		for(uint32_t j = 0; j < 3; j++){
+			cached.position[j] = sceneObjects->positions[i][j];
+			cached.rotation[j] = sceneObjects->rotations[i][j];
+			cached.scale[j] = sceneObjects->scales[i][j];
+		}
+		
+		cached.idStart = ids.size();
+		cached.idCount = sceneObjects->idCounts[i];
+		
+		for(uint32_t j = 0; j < cached.idCount; j++){
+			ids.push_back( pushCacheString(strings, getObjectId(sceneObjects, i, j)) );
+		}
+		
+		objects.push_back(cached);
+	}
+	
+	SceneCacheHeader header;
+	
+	memcpy(header.magic, sceneCacheMagic, sizeof(sceneCacheMagic));
+	header.version = SCENE_CACHE_VERSION;
+	header.sourceHash = sourceHash;
+	header.sourceSize = sourceSize;
+	header.modelCount = models.size();
+	header.objectCount = objects.size();
+	header.idCount = ids.size();
+	header.stringBytes = strings.length();
+	
+	// write to a temporary file first so another run never maps a half written cache
+	std::string temporaryPath = std::string(path) + ".tmp";
+	
+	FILE* out = fopen(temporaryPath.c_str(), "wb");
+	
+	if(out == NULL) return false;
+	
+	bool written = fwrite(&header, sizeof(header), 1, out) == 1;
+	
+	if(models.size() > 0) written = written && fwrite(models.data(), sizeof(SceneCacheModel), models.size(), out) == models.size();
+	if(objects.size() > 0) written = written && fwrite(objects.data(), sizeof(SceneCacheObject), objects.size(), out) == objects.size();
+	if(ids.size() > 0) written = written && fwrite(ids.data(), sizeof(SceneCacheString), ids.size(), out) == ids.size();
+	if(strings.length() > 0) written = written && fwrite(strings.data(), 1, strings.length(), out) == strings.length();
+	
+	written = (fclose(out) == 0) && written;
+	
+	if(!written || rename(temporaryPath.c_str(), path) != 0){
+		remove(temporaryPath.c_str());
+		return false;
+	}
+	
+	return true;
+}
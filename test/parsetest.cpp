@@ -0,0 +1,103 @@
+// parser tests
+// checks that parsing a world in parallel chunks gives the same scene as parsing it on one thread
+// build and run with `make test`
+
+#include <world.hpp>
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include <string>
+#include <random>
+
+// write a world big enough to be split into chunks, with models that are used before they're defined and redefined partway through
+std::string generateModelWorld(uint32_t objects){
+	std::string world = "# parser test world\n\n*[prop, prop, 0, 0.5, 0, 1, 2, 1]\n\n";
+	
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<double> position(-1000.0, 1000.0);
+	std::uniform_real_distribution<double> scale(0.1, 10.0);
+	
+	const char* models[] = {"cube", "prop"};
+	
+	char block[512];
+	
+	for(uint32_t i = 0; i < objects; i++){
+		// redefine models every so often (late isn't defined until the first redefinition, objects using it before then are dropped)
+		if(i > 0 && i % (objects / 5) == 0){
+			snprintf(block, sizeof(block), "*[prop, prop, 0, %u, 0, %u, 1, %u]\n*[late, late, 0, 0, 0, 2, 2, 2]\n", i % 7, i % 3 + 1, i % 5 + 1);
+			world += block;
+		}
+		
+		snprintf(block, sizeof(block), "${object%u}[%.9g, %.9g, %.9g, 0, %u, 0, %.9g, %.9g, %.9g, default, %s]\n",
+			i,
+			position(random), position(random), position(random),
+			(i % 4) * 90,
+			scale(random), scale(random), scale(random),
+			i % 1000 == 999 ? "late" : models[i % 2]
+		);
+		
+		world += block;
+	}
+	
+	// redefining cube at the very end only affects the objects after it (there aren't any)
+	world += "*[cube, cube, 0, 0, 0, 3, 1, 3]\n";
+	
+	return world;
+}
+
+// returns the first object index the scenes disagree on, or UINT32_MAX if they're the same
+uint32_t compareScenes(const Scene* a, const Scene* b){
+	const ObjectArrays* objectsA = a->objects;
+	const ObjectArrays* objectsB = b->objects;
+	
+	uint32_t count = std::min(objectsA->positions.size(), objectsB->positions.size());
+	
+	for(uint32_t i = 0; i < count; i++){
+		if(objectsA->positions[i] != objectsB->positions[i]) return i;
+		if(objectsA->rotations[i] != objectsB->rotations[i]) return i;
+		if(objectsA->scales[i] != objectsB->scales[i]) return i;
+		if(objectsA->idCounts[i] != objectsB->idCounts[i]) return i;
+		
+		for(uint32_t j = 0; j < objectsA->idCounts[i]; j++){
+			if(getObjectId(objectsA, i, j) != getObjectId(objectsB, i, j)) return i;
+		}
+	}
+	
+	if(objectsA->positions.size() != objectsB->positions.size()) return count;
+	
+	return UINT32_MAX;
+}
+
+int main(int argc, char** argv){
+	bool passed = true;
+	
+	// more than a few megabytes, so it's split into as many chunks as there are threads
+	std::string world = generateModelWorld(60000);
+	
+	printf("parsing a %.1f MB world...\n", world.size() / 1e6);
+	
+	Scene* single = createScene();
+	parseWorldBuffer(single, world.data(), world.size(), 1);
+	
+	for(uint32_t threads : {2, 3, 4, 7}){
+		Scene* parallel = createScene();
+		parseWorldBuffer(parallel, world.data(), world.size(), threads);
+		
+		uint32_t mismatch = compareScenes(single, parallel);
+		
+		if(mismatch == UINT32_MAX){
+			printf("%u threads: ok (%zu objects)\n", threads, parallel->objects->positions.size());
+		} else {
+			printf("%u threads: FAILED, object %u differs (%zu objects vs %zu on one thread)\n", threads, mismatch, parallel->objects->positions.size(), single->objects->positions.size());
+			passed = false;
+		}
+		
+		destroyScene(parallel);
+	}
+	
+	destroyScene(single);
+	
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}